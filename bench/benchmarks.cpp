@@ -0,0 +1,292 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "raytracer.hpp"
+#include "framebuffer.hpp"
+#include "pixels.hpp"
+#include "profiler.hpp"
+#include "scheduler.hpp"
+#include "scene.hpp"
+
+using namespace sdf;
+
+namespace {
+	constexpr std::size_t num_samples = 4096;
+	
+	// Restores the packet instruction set a benchmark started with on every way out of it.
+	struct PacketIsaScope {
+		PacketIsa previous = packet_isa();
+		
+		~PacketIsaScope() { set_packet_isa(previous); }
+	};
+	
+	std::vector<vec3> sample_points() {
+		std::mt19937 rng{ 42 };
+		std::uniform_real_distribution<float> dist{ -3.0f, 3.0f };
+		std::vector<vec3> points(num_samples);
+		for (auto& p : points)
+			p = { dist(rng), dist(rng), dist(rng) };
+		return points;
+	}
+	std::vector<Ray> sample_rays(int width, int height) {
+		const PerspectiveCamera camera{};
+		std::vector<Ray> rays{};
+		rays.reserve(std::size_t(width) * height);
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+				rays.push_back(camera.project((float(x) + 0.5f) / float(width), (float(y) + 0.5f) / float(height)));
+		return rays;
+	}
+	
+	std::shared_ptr<Shader> shader() {
+		static const auto s = std::make_shared<ShaderLambertian>(Color{ 0.1f, 0.1f, 0.9f, 1.0f });
+		return s;
+	}
+	std::shared_ptr<Object> cube() { return std::make_shared<Cube>(1.0f, shader()); }
+	std::shared_ptr<Object> sphere() { return std::make_shared<Sphere>(0.7f, shader()); }
+	std::shared_ptr<Object> shifted(const std::shared_ptr<Object>& obj) { return std::make_shared<Translation>(obj, vec3{ 0.3f, 0.2f, 0.1f }); }
+	
+	void set_sample_counters(benchmark::State& state, std::size_t samples) {
+		state.SetItemsProcessed(std::int64_t(samples));
+		state.counters["ns/sample"] = benchmark::Counter(double(samples), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+	}
+	
+	void evaluate(benchmark::State& state, const std::shared_ptr<Object>& object) {
+		const auto points = sample_points();
+		for (auto _ : state)
+			for (const auto& p : points)
+				benchmark::DoNotOptimize((*object)(p));
+		set_sample_counters(state, state.iterations() * points.size());
+	}
+	void evaluate_compiled(benchmark::State& state, const std::shared_ptr<Object>& object) {
+		const Program program = Program::compile(*object);
+		const auto points = sample_points();
+		for (auto _ : state)
+			for (const auto& p : points)
+				benchmark::DoNotOptimize(program.distance(p));
+		set_sample_counters(state, state.iterations() * points.size());
+	}
+}
+
+BENCHMARK_CAPTURE(evaluate, sphere, sphere());
+BENCHMARK_CAPTURE(evaluate, cube, cube());
+BENCHMARK_CAPTURE(evaluate, union, std::make_shared<Union>(cube(), shifted(sphere())));
+BENCHMARK_CAPTURE(evaluate, intersection, std::make_shared<Intersection>(cube(), shifted(sphere())));
+BENCHMARK_CAPTURE(evaluate, subtraction, std::make_shared<Subtraction>(cube(), shifted(sphere())));
+BENCHMARK_CAPTURE(evaluate, translation, shifted(cube()));
+BENCHMARK_CAPTURE(evaluate, rotation_x, std::make_shared<RotationX>(cube(), 0.5f));
+BENCHMARK_CAPTURE(evaluate, rotation_y, std::make_shared<RotationY>(cube(), 0.5f));
+BENCHMARK_CAPTURE(evaluate, demo_scene, demo_scene());
+BENCHMARK_CAPTURE(evaluate_compiled, cube, cube());
+BENCHMARK_CAPTURE(evaluate_compiled, demo_scene, demo_scene());
+
+static void evaluate_fixed(benchmark::State& state) {
+	const auto scene = fixed_demo_scene();
+	const auto points = sample_points();
+	for (auto _ : state)
+		for (const auto& p : points)
+			benchmark::DoNotOptimize(scene->field.distance(p));
+	set_sample_counters(state, state.iterations() * points.size());
+}
+BENCHMARK(evaluate_fixed);
+
+static void normal(benchmark::State& state) {
+	const auto scene = demo_scene();
+	const auto points = sample_points();
+	for (auto _ : state)
+		for (const auto& p : points)
+			benchmark::DoNotOptimize(scene->normal(p + vec3{ 0.0f, 0.0f, -10.0f }));
+	set_sample_counters(state, state.iterations() * points.size());
+}
+BENCHMARK(normal);
+
+static void normal_compiled(benchmark::State& state) {
+	const CompiledObject scene{ *demo_scene() };
+	const auto points = sample_points();
+	for (auto _ : state)
+		for (const auto& p : points)
+			benchmark::DoNotOptimize(scene.normal(p + vec3{ 0.0f, 0.0f, -10.0f }));
+	set_sample_counters(state, state.iterations() * points.size());
+}
+BENCHMARK(normal_compiled);
+
+static void normal_fixed(benchmark::State& state) {
+	const auto scene = fixed_demo_scene();
+	const auto points = sample_points();
+	for (auto _ : state)
+		for (const auto& p : points)
+			benchmark::DoNotOptimize(scene->normal(p + vec3{ 0.0f, 0.0f, -10.0f }));
+	set_sample_counters(state, state.iterations() * points.size());
+}
+BENCHMARK(normal_fixed);
+
+// `steps` are march steps summed over all rays, shading and shadow samples are not part of them.
+static void set_ray_counters(benchmark::State& state, std::size_t rays, std::size_t steps) {
+	state.SetItemsProcessed(std::int64_t(rays));
+	state.counters["rays/s"] = benchmark::Counter(double(rays), benchmark::Counter::kIsRate);
+	if (steps) state.counters["steps/ray"] = double(steps) / double(rays);
+}
+
+static void trace_dynamic(benchmark::State& state) {
+	const auto scene = demo_scene();
+	const auto rays = sample_rays(160, 90);
+	for (auto _ : state)
+		for (const auto& ray : rays)
+			benchmark::DoNotOptimize(trace(scene, ray));
+	// the same march trace() runs, outside of the timing
+	std::size_t steps = 0;
+	for (const auto& ray : rays) {
+		const float far = std::min(1000.0f, exit_distance(scene->bounds(), ray));
+		steps += std::size_t(march([&](vec3 p) { return (*scene)(p).first; }, ray, far, march_settings()).steps);
+	}
+	set_ray_counters(state, state.iterations() * rays.size(), state.iterations() * steps);
+}
+BENCHMARK(trace_dynamic);
+
+static void trace_compiled(benchmark::State& state) {
+	const auto scene = std::make_shared<CompiledObject>(*demo_scene());
+	const auto rays = sample_rays(160, 90);
+	for (auto _ : state)
+		for (const auto& ray : rays)
+			benchmark::DoNotOptimize(trace(scene, ray));
+	std::size_t steps = 0;
+	for (const auto& ray : rays)
+		steps += std::size_t(march(scene->program, ray).steps);
+	set_ray_counters(state, state.iterations() * rays.size(), state.iterations() * steps);
+}
+BENCHMARK(trace_compiled);
+
+static void trace_fixed(benchmark::State& state) {
+	const auto scene = fixed_demo_scene();
+	const auto rays = sample_rays(160, 90);
+	for (auto _ : state)
+		for (const auto& ray : rays)
+			benchmark::DoNotOptimize(trace(scene, ray));
+	std::size_t steps = 0;
+	for (const auto& ray : rays) {
+		const float far = std::min(1000.0f, exit_distance(scene->field.bounds(), ray));
+		steps += std::size_t(march([&](vec3 p) { return scene->field.distance(p); }, ray, far, march_settings()).steps);
+	}
+	set_ray_counters(state, state.iterations() * rays.size(), state.iterations() * steps);
+}
+BENCHMARK(trace_fixed);
+
+static void march_relaxed(benchmark::State& state) {
+	const auto previous = march_settings();
+	auto settings = previous;
+	settings.relaxation = float(state.range(0)) / 10.0f;
+	set_march_settings(settings);
+	const CompiledObject scene{ *demo_scene() };
+	const auto rays = sample_rays(160, 90);
+	std::size_t steps = 0;
+	for (auto _ : state)
+		for (const auto& ray : rays)
+			steps += std::size_t(march(scene.program, ray).steps);
+	set_march_settings(previous);
+	set_ray_counters(state, state.iterations() * rays.size(), steps);
+}
+BENCHMARK(march_relaxed)->ArgName("relaxation*10")->Arg(10)->Arg(16);
+
+static void trace_packets(benchmark::State& state) {
+	const PacketIsaScope restore{};
+	const auto isa = PacketIsa(state.range(0));
+	if (set_packet_isa(isa) != isa) {
+		state.SkipWithError("instruction set not supported");
+		return;
+	}
+	const auto scene = std::make_shared<CompiledObject>(*demo_scene());
+	const auto rays = sample_rays(160, 90);
+	std::vector<Color> colors(rays.size());
+	for (auto _ : state) {
+		trace_packet(scene, rays.data(), rays.size(), colors.data());
+		benchmark::DoNotOptimize(colors.data());
+	}
+	std::vector<PixelCost> costs(rays.size());
+	trace_packet(scene, rays.data(), rays.size(), colors.data(), 1000.0f, nullptr, nullptr, costs.data());
+	std::size_t steps = 0;
+	for (const auto& cost : costs)
+		steps += cost.steps;
+	set_ray_counters(state, state.iterations() * rays.size(), state.iterations() * steps);
+}
+BENCHMARK(trace_packets)->Arg(int(PacketIsa::Scalar))->Arg(int(PacketIsa::SSE))->Arg(int(PacketIsa::AVX2));
+
+static void encode_row(benchmark::State& state) {
+	const PixelEncoding encoding{ state.range(0) != 0, state.range(1) != 0 };
+	std::vector<Color> colors(1920);
+	for (std::size_t i = 0; i < colors.size(); ++i)
+		colors[i] = { float(i % 300) / 256.0f, 0.5f, 1.0f - float(i) / 1920.0f, 1.0f };
+	std::vector<std::uint32_t> pixels(colors.size());
+	for (auto _ : state) {
+		encode_argb(colors.data(), pixels.data(), colors.size(), 0, 0, encoding);
+		benchmark::DoNotOptimize(pixels.data());
+	}
+	state.SetItemsProcessed(std::int64_t(state.iterations() * colors.size()));
+}
+BENCHMARK(encode_row)->ArgNames({ "srgb", "dither" })->ArgsProduct({ { 0, 1 }, { 0, 1 } });
+
+static void load_instances(benchmark::State& state) {
+	std::string text = "material m lambertian 1 1 1\nscene instances cube 0.8 m {\n";
+	for (int i = 0; i < state.range(0); ++i)
+		text += std::to_string(i % 256 * 2) + " 0 " + std::to_string(i / 256 * 2) + "\n";
+	text += "}\n";
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Program::compile(*parse_scene(text)));
+	state.SetItemsProcessed(std::int64_t(state.iterations() * state.range(0)));
+}
+BENCHMARK(load_instances)->Arg(1000)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+static void load_graph(benchmark::State& state) {
+	std::string text = "material m lambertian 1 1 1\nscene union {\n";
+	for (int i = 0; i < 10000; ++i)
+		text += "translate " + std::to_string(i % 100 * 2) + " 0 " + std::to_string(i / 100 * 2) + " sphere 0.8 m\n";
+	text += "}\n";
+	// 0 stops at the graph, 1 compiles it directly and 2 through the frozen object tree
+	for (auto _ : state) {
+		if (state.range(0) == 2) benchmark::DoNotOptimize(Program::compile(*parse_scene(text)));
+		else if (state.range(0) == 1) benchmark::DoNotOptimize(parse_scene_graph(text).compile());
+		else benchmark::DoNotOptimize(parse_scene_graph(text));
+	}
+	state.SetItemsProcessed(std::int64_t(state.iterations() * 10000));
+}
+BENCHMARK(load_graph)->ArgName("program")->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+
+static void frame(benchmark::State& state) {
+	const int width = int(state.range(0)), height = int(state.range(1));
+	const auto object = std::make_shared<CompiledObject>(*demo_scene());
+	const PerspectiveCamera camera{};
+	Framebuffer fb{ width, height };
+	TaskPool pool{ std::size_t(state.range(2)) };
+	
+	constexpr int tile = 16;
+	const int tilesX = (width + tile - 1) / tile, tilesY = (height + tile - 1) / tile;
+	for (auto _ : state) {
+		pool.run(std::size_t(tilesX * tilesY), [&](std::size_t i) {
+			const int tx = int(i) % tilesX, ty = int(i) / tilesX;
+			render(fb, camera, object, ty * tile, tile, tx * tile, tile);
+		});
+	}
+	// the tiles render() traces, once more with their costs
+	std::size_t steps = 0;
+	std::vector<Color> colors(std::size_t(tile) * tile);
+	std::vector<PixelCost> costs(colors.size());
+	for (int ty = 0; ty < tilesY; ++ty) {
+		for (int tx = 0; tx < tilesX; ++tx) {
+			const int w = std::min(tile, width - tx * tile), h = std::min(tile, height - ty * tile);
+			std::fill(costs.begin(), costs.end(), PixelCost{});
+			trace_region(object, camera, width, height, tx * tile, ty * tile, w, h, colors.data(), nullptr, -1, 1000.0f, nullptr, nullptr, costs.data());
+			for (const auto& cost : costs)
+				steps += cost.steps;
+		}
+	}
+	set_ray_counters(state, state.iterations() * std::size_t(width) * height, state.iterations() * steps);
+}
+BENCHMARK(frame)
+	->ArgNames({ "width", "height", "threads" })
+	->ArgsProduct({ { 160 }, { 90 }, { 1, 2, 4, 8 } })
+	->ArgsProduct({ { 640 }, { 360 }, { 1, 2, 4, 8 } })
+	->ArgsProduct({ { 1920 }, { 1080 }, { 1, 4, 8 } })
+	->Unit(benchmark::kMillisecond)
+	->UseRealTime();
+
+BENCHMARK_MAIN();
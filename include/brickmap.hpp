@@ -0,0 +1,57 @@
+#ifndef SDF_BRICKMAP_HPP
+#define SDF_BRICKMAP_HPP
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "march.hpp"
+#include "program.hpp"
+
+namespace sdf {
+	class TaskPool;
+	struct PerspectiveCamera;
+	
+	// Sparse distance cache of a static scene. Cells near the surface own a brick
+	// of brick_size^3 voxels, all other cells only keep a conservative coarse distance.
+	// A lookup costs the same for any scene, but cached rays are marched one by one instead of in packets and still take
+	// their last steps and all of their shading on the exact program. The cache only pays off for programs far slower to
+	// evaluate than a lookup, the demo scene and smooth blends of a few hundred spheres trace faster without it.
+	class BrickMap {
+	public:
+		static constexpr int brick_size = 8;
+		static constexpr std::size_t default_budget = std::size_t(64) << 20;
+		
+		Bounds box{};
+		float voxel = 0.0f;
+		int cells[3]{};
+		std::vector<float> coarse;
+		std::vector<std::int32_t> bricks;
+		std::vector<float> samples;
+		
+		// Throws std::length_error, naming a voxel size that about fits, if the map would take more than `budget` bytes.
+		[[nodiscard]]
+		static BrickMap build(const Object& scene, float voxel, TaskPool& pool, std::size_t budget = default_budget);
+		
+		[[nodiscard]]
+		bool empty() const noexcept { return coarse.empty(); }
+		[[nodiscard]]
+		std::size_t memory() const noexcept;
+		
+		// Lower bound of the distance, only approximate (within a voxel) inside bricks.
+		[[nodiscard]]
+		float sample(vec3 p) const noexcept;
+	};
+	
+	// Marches like march(const Program&, ...) with the cache as the distance, the exact program takes over where a cached
+	// bound is small enough to pass for a hit.
+	[[nodiscard]]
+	MarchResult march(const BrickMap& cache, const Program& program, const Ray& ray, float bgDist = 1000.0f, float start = 0.0f) noexcept;
+	// Marches through the cache and shades with the exact SDF.
+	[[nodiscard]]
+	Color trace(const BrickMap& cache, const std::shared_ptr<CompiledObject>& object, Ray ray, float bgDist = 1000.0f, float start = 0.0f);
+	// Traces pixels like trace_region() without history, every cone_tile sized tile starts at the depth of a cone marched
+	// through the cache.
+	void trace_region(const BrickMap& cache, const std::shared_ptr<CompiledObject>& object, const PerspectiveCamera& camera, int width, int height,
+		int xoff, int yoff, int xsize, int ysize, Color* out, float bgDist = 1000.0f);
+}
+
+#endif /* SDF_BRICKMAP_HPP */
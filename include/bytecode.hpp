@@ -0,0 +1,53 @@
+#ifndef SDF_BYTECODE_HPP
+#define SDF_BYTECODE_HPP
+#include <cstdint>
+#include <cstddef>
+
+namespace sdf {
+	enum class Opcode : std::uint32_t {
+		Sphere,
+		Cube,
+		Translate,
+		RotateX,
+		RotateY,
+		Pop,
+		Union,
+		Intersection,
+		Subtraction,
+		Infinity,
+		Cull,
+		Order,
+		Repeat,
+		Mirror,
+		SmoothUnion,
+		SmoothIntersection,
+		SmoothSubtraction,
+		Affine,
+		Operand,
+		Scale,
+	};
+	
+	// Primitives push a distance, transforms push a point (undone by Pop),
+	// CSG operations combine the two topmost distances.
+	// Cull skips the next `material` instructions if the bounding box in args
+	// is at least as far away as the topmost distance.
+	// Repeat folds the point by the periods in args[0..2] and limits in args[3..5], Mirror takes the absolute
+	// value of the coordinates flagged in args[0..2]. Smooth operations blend with the radius in args[0].
+	// Affine maps the point by the matrix rows in its own args and the first half of the following
+	// Operand, plus the offset in the second half. Operands never run on their own.
+	// Scale multiplies the topmost distance by args[0], it follows the object of a stretching Affine.
+	// Order is followed by two blocks of `material` and `length` instructions, it runs the second one
+	// first if coordinate args[0] of the point is at least args[1]. Nearer blocks first cull more.
+	struct Instruction {
+		Opcode op;
+		std::uint32_t material;
+		float args[6];
+		std::uint32_t length = 0;
+	};
+	
+	constexpr std::size_t max_stack_depth = 64;
+	// Deeper Order nesting falls back to running the blocks as they are stored.
+	constexpr std::size_t max_order_depth = 64;
+}
+
+#endif /* SDF_BYTECODE_HPP */
@@ -0,0 +1,73 @@
+#ifndef SDF_DISTRIBUTED_HPP
+#define SDF_DISTRIBUTED_HPP
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <sys/types.h>
+#include "framebuffer.hpp"
+
+namespace sdf {
+	// Rectangle of a frame, clipped to it by the coordinator, and the number of that frame in an animation.
+	struct Tile {
+		std::int32_t x, y, width, height;
+		std::int32_t frame;
+	};
+	
+	// Renders frames by handing tiles to worker processes on the same host.
+	// Workers are forked from the calling process, so they share its scene, camera and settings as of the fork.
+	// Each one answers tile requests on a local socket by calling `render` and streaming the tile's rows back.
+	// Tiles of a worker that dies, breaks the protocol or spends longer than the timeout on one tile go to the remaining workers.
+	class TileWorkers {
+	public:
+		// Renders the tile into a frame of the coordinator's size, only the tile's pixels are sent back.
+		using Renderer = std::function<void(Framebuffer&, const Tile&)>;
+		
+		// Forks `count` workers, call before starting threads since only the calling thread survives the fork.
+		// Throws std::system_error if not a single worker could be started.
+		TileWorkers(std::size_t count, int width, int height, PixelEncoding encoding, const Renderer& render,
+			std::chrono::milliseconds timeout = std::chrono::seconds(10));
+		TileWorkers(const TileWorkers&) = delete;
+		TileWorkers& operator=(const TileWorkers&) = delete;
+		// Closes the sockets, which ends the workers, and reaps them.
+		~TileWorkers();
+		
+		// Number of workers still alive.
+		[[nodiscard]]
+		std::size_t size() const noexcept { return workers.size(); }
+		
+		// Renders every tile of a frame of the constructor's size, keeping up to two requests in flight per worker.
+		// Returns false if all workers died before the frame was complete.
+		[[nodiscard]]
+		bool render(Framebuffer& fb, int tile, int frame = 0);
+	private:
+		using Clock = std::chrono::steady_clock;
+		
+		struct Worker {
+			pid_t pid;
+			int fd;
+			// requested tiles in the order their rows come back
+			std::deque<Tile> pending;
+			// reply to the first pending tile as far as it arrived, and when it has to be complete
+			std::vector<std::uint8_t> reply{};
+			std::size_t received = 0;
+			Clock::time_point deadline{};
+		};
+		
+		int width, height;
+		std::chrono::milliseconds timeout;
+		std::vector<Worker> workers;
+		
+		// Requeues the worker's tiles at the front of `queue`, kills and reaps it.
+		void drop(std::size_t index, std::deque<Tile>& queue) noexcept;
+		// Starts the clock on the worker's first pending tile, the one it answers next.
+		void expect(Worker& worker) const;
+		// Reads what the worker has sent so far without blocking, copies finished tiles into `fb` and counts them off `remaining`.
+		// Returns false if the worker is gone or broke the protocol, the tiles it finished before still count.
+		[[nodiscard]]
+		bool receive(Worker& worker, Framebuffer& fb, std::size_t& remaining) const;
+	};
+}
+
+#endif /* SDF_DISTRIBUTED_HPP */
@@ -0,0 +1,347 @@
+#ifndef SDF_FIXED_HPP
+#define SDF_FIXED_HPP
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "object.hpp"
+#include "program.hpp"
+#include "primitives.hpp"
+#include "lighting.hpp"
+#include "march.hpp"
+#include "raytracer.hpp"
+#include "framebuffer.hpp"
+#include "profiler.hpp"
+
+// Scenes fixed at build time, written as nested value types:
+//   fixed::Union{ fixed::Translate{ fixed::Cube{ 1.0f }, { 1.8f, 0.0f, -10.0f } }, fixed::Sphere{ 0.5f, 1 } }
+// The whole tree is one type, so its distance function inlines into a single function without
+// virtual calls or pointer chasing. Materials index the palette of the FixedObject that holds the scene.
+namespace sdf::fixed {
+	struct Sample {
+		float distance;
+		std::uint32_t material;
+	};
+	using Palette = std::vector<std::shared_ptr<Shader>>;
+	
+	template<class T>
+	concept Field = std::copy_constructible<T> && requires(const T& field, vec3 p, Program& program, const Palette& materials) {
+		{ field.distance(p) } -> std::same_as<float>;
+		{ field.sample(p) } -> std::same_as<Sample>;
+		{ field.gradient(p) } -> std::same_as<vec3>;
+		{ field.bounds() } -> std::same_as<Bounds>;
+		// emits the same field as bytecode, for scenes that are edited after all
+		field.compile(program, materials);
+	};
+	
+	struct Sphere {
+		float radius;
+		std::uint32_t material = 0;
+		
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept { return sphere_distance(p, radius); }
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept { return { distance(p), material }; }
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept { return sphere_gradient(p); }
+		[[nodiscard]]
+		Bounds bounds() const noexcept { return { vec3{ -radius }, vec3{ radius } }; }
+		void compile(Program& program, const Palette& materials) const {
+			program.emit(Opcode::Sphere, radius, 0.0f, 0.0f, program.material(materials.at(material)));
+		}
+	};
+	struct Cube {
+		float size;
+		std::uint32_t material = 0;
+		
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept { return cube_distance(p, size); }
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept { return { distance(p), material }; }
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept { return cube_gradient(p, size); }
+		[[nodiscard]]
+		Bounds bounds() const noexcept { return { vec3{ -size / 2 }, vec3{ size / 2 } }; }
+		void compile(Program& program, const Palette& materials) const {
+			program.emit(Opcode::Cube, size, 0.0f, 0.0f, program.material(materials.at(material)));
+		}
+	};
+	
+	template<Field T>
+	struct Translate {
+		T object;
+		vec3 offset;
+		
+		constexpr Translate(T object, vec3 offset) noexcept : object(std::move(object)), offset(offset) {}
+		
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept { return object.distance(p - offset); }
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept { return object.sample(p - offset); }
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept { return object.gradient(p - offset); }
+		[[nodiscard]]
+		Bounds bounds() const noexcept {
+			const auto b = object.bounds();
+			return { b.lower + offset, b.upper + offset };
+		}
+		void compile(Program& program, const Palette& materials) const {
+			program.emit(Opcode::Translate, offset.x, offset.y, offset.z);
+			object.compile(program, materials);
+			program.emit(Opcode::Pop);
+		}
+	};
+	// Rotations take their sines and cosines once, when the scene is built.
+	template<Field T>
+	struct RotateX {
+		T object;
+		float sinr, cosr;
+		
+		RotateX(T object, float angle) noexcept : object(std::move(object)), sinr(std::sin(angle)), cosr(std::cos(angle)) {}
+		
+		[[nodiscard]]
+		vec3 local(vec3 p) const noexcept { return { p.x, cosr * p.y - sinr * p.z, sinr * p.y + cosr * p.z }; }
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept { return object.distance(local(p)); }
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept { return object.sample(local(p)); }
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept {
+			const vec3 g = object.gradient(local(p));
+			return { g.x, cosr * g.y + sinr * g.z, cosr * g.z - sinr * g.y };
+		}
+		[[nodiscard]]
+		Bounds bounds() const noexcept {
+			return transform_bounds(object.bounds(), [this](vec3 p) {
+				return vec3{ p.x, cosr * p.y + sinr * p.z, cosr * p.z - sinr * p.y };
+			});
+		}
+		void compile(Program& program, const Palette& materials) const {
+			program.emit(Opcode::RotateX, sinr, cosr);
+			object.compile(program, materials);
+			program.emit(Opcode::Pop);
+		}
+	};
+	template<Field T>
+	struct RotateY {
+		T object;
+		float sinr, cosr;
+		
+		RotateY(T object, float angle) noexcept : object(std::move(object)), sinr(std::sin(angle)), cosr(std::cos(angle)) {}
+		
+		[[nodiscard]]
+		vec3 local(vec3 p) const noexcept { return { cosr * p.x - sinr * p.z, p.y, sinr * p.x + cosr * p.z }; }
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept { return object.distance(local(p)); }
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept { return object.sample(local(p)); }
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept {
+			const vec3 g = object.gradient(local(p));
+			return { cosr * g.x + sinr * g.z, g.y, cosr * g.z - sinr * g.x };
+		}
+		[[nodiscard]]
+		Bounds bounds() const noexcept {
+			return transform_bounds(object.bounds(), [this](vec3 p) {
+				return vec3{ cosr * p.x + sinr * p.z, p.y, cosr * p.z - sinr * p.x };
+			});
+		}
+		void compile(Program& program, const Palette& materials) const {
+			program.emit(Opcode::RotateY, sinr, cosr);
+			object.compile(program, materials);
+			program.emit(Opcode::Pop);
+		}
+	};
+	
+	// Nearest of any number of members, ties go to the later one like nested sdf::Union nodes.
+	template<Field... Ts>
+	struct Union {
+		std::tuple<Ts...> members;
+		
+		constexpr explicit Union(Ts... members) noexcept : members(std::move(members)...) {}
+		
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept {
+			return std::apply([p](const auto&... m) {
+				float d = std::numeric_limits<float>::infinity();
+				((d = std::min(d, m.distance(p))), ...);
+				return d;
+			}, members);
+		}
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept {
+			return std::apply([p](const auto&... m) {
+				Sample best{ std::numeric_limits<float>::infinity(), 0 };
+				((best = [&](Sample s) { return best.distance < s.distance ? best : s; }(m.sample(p))), ...);
+				return best;
+			}, members);
+		}
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept {
+			return std::apply([p](const auto&... m) {
+				float best = std::numeric_limits<float>::infinity();
+				vec3 g{};
+				([&] {
+					const float d = m.distance(p);
+					if (!(best < d)) best = d, g = m.gradient(p);
+				}(), ...);
+				return g;
+			}, members);
+		}
+		[[nodiscard]]
+		Bounds bounds() const noexcept {
+			return std::apply([](const auto&... m) {
+				Bounds b{ vec3{ std::numeric_limits<float>::infinity() }, vec3{ -std::numeric_limits<float>::infinity() } };
+				((b = merge(b, m.bounds())), ...);
+				return b;
+			}, members);
+		}
+		void compile(Program& program, const Palette& materials) const {
+			std::apply([&](const auto& first, const auto&... rest) {
+				first.compile(program, materials);
+				((rest.compile(program, materials), program.emit(Opcode::Union)), ...);
+			}, members);
+		}
+	};
+	template<Field A, Field B>
+	struct Intersection {
+		A obj1;
+		B obj2;
+		
+		constexpr Intersection(A obj1, B obj2) noexcept : obj1(std::move(obj1)), obj2(std::move(obj2)) {}
+		
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept { return std::max(obj1.distance(p), obj2.distance(p)); }
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept {
+			const Sample a = obj1.sample(p), b = obj2.sample(p);
+			return a.distance > b.distance ? a : b;
+		}
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept { return obj1.distance(p) > obj2.distance(p) ? obj1.gradient(p) : obj2.gradient(p); }
+		[[nodiscard]]
+		Bounds bounds() const noexcept { return intersect(obj1.bounds(), obj2.bounds()); }
+		void compile(Program& program, const Palette& materials) const {
+			obj1.compile(program, materials);
+			obj2.compile(program, materials);
+			program.emit(Opcode::Intersection);
+		}
+	};
+	template<Field A, Field B>
+	struct Subtraction {
+		A obj1;
+		B obj2;
+		
+		constexpr Subtraction(A obj1, B obj2) noexcept : obj1(std::move(obj1)), obj2(std::move(obj2)) {}
+		
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept { return std::max(obj1.distance(p), -obj2.distance(p)); }
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept {
+			const Sample a = obj1.sample(p);
+			Sample b = obj2.sample(p);
+			b.distance = -b.distance;
+			return a.distance > b.distance ? a : b;
+		}
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept { return obj1.distance(p) > -obj2.distance(p) ? obj1.gradient(p) : -obj2.gradient(p); }
+		[[nodiscard]]
+		Bounds bounds() const noexcept { return obj1.bounds(); }
+		void compile(Program& program, const Palette& materials) const {
+			obj1.compile(program, materials);
+			obj2.compile(program, materials);
+			program.emit(Opcode::Subtraction);
+		}
+	};
+}
+
+namespace sdf {
+	// Plugs a fixed scene into the renderers and shaders. Marching through trace() inlines the whole
+	// distance function, shaders still reach it through one virtual call per sample.
+	template<fixed::Field F>
+	class FixedObject final : public Object {
+	public:
+		F field;
+		fixed::Palette materials;
+		
+		FixedObject(F field, fixed::Palette materials) : field(std::move(field)), materials(std::move(materials)) {}
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override {
+			const auto s = field.sample(p);
+			return { s.distance, materials[s.material] };
+		}
+		void compile(Program& program) const override { field.compile(program, materials); }
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override {
+			++thread_evaluations;
+			return field.gradient(p);
+		}
+		[[nodiscard]]
+		float shadow(vec3 p, vec3 n, vec3 light) const noexcept override {
+			const auto& settings = lighting_settings();
+			if (!settings.shadows) return 1.0f;
+			const Ray ray{ p + n * settings.bias, light };
+			const float far = std::min(settings.shadow_distance, exit_distance(field.bounds(), ray));
+			return soft_shadow([this](vec3 q) { return field.distance(q); }, ray, far, settings).visibility;
+		}
+		[[nodiscard]]
+		float occlusion(vec3 p, vec3 n) const noexcept override {
+			const auto& settings = lighting_settings();
+			if (!settings.occlusion) return 1.0f;
+			return ambient_occlusion([this](vec3 q) { return field.distance(q); }, p, n, settings);
+		}
+		[[nodiscard]]
+		Bounds bounds() const noexcept override { return field.bounds(); }
+	};
+	
+	template<fixed::Field F>
+	[[nodiscard]]
+	std::shared_ptr<FixedObject<F>> make_fixed(F field, fixed::Palette materials) {
+		return std::make_shared<FixedObject<F>>(std::move(field), std::move(materials));
+	}
+	
+	// Marches the fixed scene within its bounds and bgDist, then shades the hit like trace() on any object.
+	template<fixed::Field F>
+	[[nodiscard]]
+	Color trace(const std::shared_ptr<FixedObject<F>>& object, Ray ray, float bgDist = 1000.0f) {
+		const auto& field = object->field;
+		const float far = std::min(bgDist, exit_distance(field.bounds(), ray));
+		const auto result = march([&field](vec3 p) { return field.distance(p); }, ray, far, march_settings());
+		ray.origin += ray.direction * result.t;
+		if (result.end == MarchEnd::Sky)
+			return project_background(ray);
+		++thread_evaluations;
+		return object->materials[field.sample(ray.origin).material]->shade(ray, object);
+	}
+	
+	// Traces every pixel of the region on its own, without packets, cone tiles or reprojection.
+	template<fixed::Field F>
+	void render(Framebuffer& fb, const PerspectiveCamera& camera, const std::shared_ptr<FixedObject<F>>& obj, int yoff = 0, int ysize = INT32_MAX, int xoff = 0, int xsize = INT32_MAX) {
+		const int gw = fb.width, gh = fb.height;
+		yoff = std::clamp(yoff, 0, gh);
+		ysize = std::clamp(ysize, 0, gh - yoff);
+		xoff = std::clamp(xoff, 0, gw);
+		xsize = std::clamp(xsize, 0, gw - xoff);
+		std::vector<Color> colors(std::size_t(xsize) * ysize);
+		{
+			ProfileScope scope{ Stage::March };
+			for (int y = 0; y < ysize; ++y) {
+				for (int x = 0; x < xsize; ++x) {
+					const Ray ray = camera.project((float(xoff + x) + 0.5f) / float(gw), (float(yoff + y) + 0.5f) / float(gh));
+					colors[std::size_t(y) * xsize + x] = trace(obj, ray);
+				}
+			}
+		}
+		ProfileScope scope{ Stage::Blit };
+		for (int y = 0; y < ysize; ++y)
+			fb.store(xoff, yoff + y, &colors[std::size_t(y) * xsize], std::size_t(xsize));
+	}
+}
+
+#endif /* SDF_FIXED_HPP */
@@ -0,0 +1,38 @@
+#ifndef SDF_FRAMEBUFFER_HPP
+#define SDF_FRAMEBUFFER_HPP
+#include <cstdint>
+#include <climits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "math.hpp"
+#include "pixels.hpp"
+#include "region.hpp"
+
+namespace sdf {
+	struct PerspectiveCamera;
+	class CompiledObject;
+	
+	// Plain RGBA8 image, rows are stored top to bottom without padding.
+	struct Framebuffer {
+		int width, height;
+		std::vector<std::uint8_t> pixels;
+		PixelEncoding encoding{};
+		
+		Framebuffer(int width, int height) : width(width), height(height), pixels(std::size_t(width) * height * 4) {}
+		
+		void store(int x, int y, Color color) noexcept;
+		// Stores `count` colors starting at pixel (x, y) and going right.
+		void store(int x, int y, const Color* colors, std::size_t count) noexcept;
+		[[nodiscard]]
+		bool write_ppm(const std::string& path) const;
+		[[nodiscard]]
+		bool write_png(const std::string& path) const;
+		[[nodiscard]]
+		bool write(const std::string& path) const;
+	};
+	
+	void render(Framebuffer& fb, const PerspectiveCamera& camera, const std::shared_ptr<CompiledObject>& obj, int yoff = 0, int ysize = INT32_MAX, int xoff = 0, int xsize = INT32_MAX, const RenderOptions& options = {});
+}
+
+#endif /* SDF_FRAMEBUFFER_HPP */
@@ -0,0 +1,30 @@
+#ifndef SDF_GOVERNOR_HPP
+#define SDF_GOVERNOR_HPP
+#include <cstddef>
+
+namespace sdf {
+	struct RenderQuality {
+		// fraction of the full resolution along each axis
+		float scale;
+		// trace only every other pixel in a checkerboard pattern and reconstruct the rest
+		bool checkerboard;
+	};
+	
+	// Picks the render quality of the next frame so that frames take about 1 / target_fps seconds.
+	class FrameGovernor {
+	public:
+		explicit FrameGovernor(float target_fps) noexcept;
+		
+		[[nodiscard]]
+		RenderQuality quality() const noexcept;
+		// Feeds the render time of the last frame, a still camera returns to full quality after a few frames.
+		RenderQuality update(float seconds, bool moving) noexcept;
+	private:
+		float budget;
+		float average = 0.0f;
+		std::size_t level = 0, resume = 0;
+		int settle = 0, still = 0;
+	};
+}
+
+#endif /* SDF_GOVERNOR_HPP */
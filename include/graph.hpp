@@ -0,0 +1,123 @@
+#ifndef SDF_GRAPH_HPP
+#define SDF_GRAPH_HPP
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "object.hpp"
+#include "program.hpp"
+#include "shader.hpp"
+
+namespace sdf {
+	using NodeId = std::uint32_t;
+	using MaterialId = std::uint32_t;
+	constexpr NodeId no_node = UINT32_MAX;
+	
+	enum class NodeKind : std::uint8_t {
+		Sphere,
+		Cube,
+		Translation,
+		RotationX,
+		RotationY,
+		Union,
+		Intersection,
+		Subtraction,
+		Affine,
+		Repetition,
+		Mirror,
+		SmoothUnion,
+		SmoothIntersection,
+		SmoothSubtraction,
+		Instances,
+	};
+	
+	struct Node {
+		NodeKind kind;
+		// children, no_node where the kind has fewer
+		NodeId first = no_node, second = no_node;
+		// material of primitives, first entry of the offset table for instances
+		std::uint32_t index = 0;
+		// number of offsets of instances
+		std::uint32_t count = 0;
+		// radius, size, angle or blend radius first, then translation, period and limit, mirrored axes
+		// or the rows and offset of an affine map
+		std::array<float, 12> params{};
+	};
+	
+	// Scene storage in three flat tables: nodes linked by index, materials and instance offsets.
+	// Children always precede their parents, so building, compiling and freezing walk the nodes in memory order.
+	// Nodes are never removed, an edit either updates a node or adds new nodes and moves the root.
+	class SceneGraph {
+	public:
+		NodeId root = no_node;
+		
+		[[nodiscard]]
+		std::size_t size() const noexcept { return nodes.size(); }
+		void reserve(std::size_t count) { nodes.reserve(count); }
+		[[nodiscard]]
+		const Node& operator[](NodeId id) const noexcept { return nodes[id]; }
+		// Replaces a node, checked like adding it with its children preceding `id`. The space the node covered before
+		// and covers now counts as changed. Throws std::out_of_range for unknown nodes and bad links.
+		void update(NodeId id, const Node& node);
+		// Increases with every update(), callers recompile when it moves.
+		[[nodiscard]]
+		std::uint64_t version() const noexcept { return edits; }
+		// Box around everything update() changed below the root since the last commit_changes(), in the root's space,
+		// nullopt if nothing changed. Moving the root is not tracked.
+		[[nodiscard]]
+		std::optional<Bounds> changes() const;
+		void commit_changes() noexcept { touched.clear(); }
+		
+		[[nodiscard]]
+		MaterialId material(const std::shared_ptr<Shader>& shader);
+		[[nodiscard]]
+		const std::shared_ptr<Shader>& shader(MaterialId id) const noexcept { return materials[id]; }
+		
+		// Adding a node whose children do not exist yet throws std::out_of_range.
+		NodeId sphere(float radius, MaterialId material);
+		NodeId cube(float size, MaterialId material);
+		NodeId translation(NodeId object, vec3 offset);
+		NodeId rotation_x(NodeId object, float angle);
+		NodeId rotation_y(NodeId object, float angle);
+		NodeId unite(NodeId a, NodeId b);
+		NodeId intersection(NodeId a, NodeId b);
+		NodeId subtraction(NodeId a, NodeId b);
+		NodeId affine(NodeId object, vec3 x, vec3 y, vec3 z, vec3 offset);
+		NodeId repetition(NodeId object, vec3 period, vec3 limit = vec3{ std::numeric_limits<float>::infinity() });
+		NodeId mirror(NodeId object, bool x, bool y, bool z);
+		NodeId smooth_union(NodeId a, NodeId b, float k);
+		NodeId smooth_intersection(NodeId a, NodeId b, float k);
+		NodeId smooth_subtraction(NodeId a, NodeId b, float k);
+		NodeId instances(NodeId object, const std::vector<vec3>& offsets);
+		
+		// Bytecode of the root straight from the tables, the program Program::compile() makes of freeze().
+		// Throws std::runtime_error without a root and std::out_of_range if a link does not point at an earlier node.
+		[[nodiscard]]
+		Program compile() const;
+		// Object tree of the root, each node reached from the root becomes one object and shared nodes stay shared.
+		// Chains of transforms are fused like Affine::fuse() does. Throws like compile().
+		[[nodiscard]]
+		std::shared_ptr<Object> freeze() const;
+	private:
+		std::vector<Node> nodes;
+		std::vector<std::shared_ptr<Shader>> materials;
+		std::vector<vec3> offsets;
+		std::uint64_t edits = 0;
+		// updated nodes and the space they changed in their own
+		std::vector<std::pair<NodeId, Bounds>> touched;
+		
+		struct Layout;
+		
+		void check(NodeId id, const Node& node) const;
+		NodeId add(const Node& node);
+		// Fused transforms and bounds of the nodes reached from `top`, checking their links on the way.
+		[[nodiscard]]
+		Layout layout(NodeId top) const;
+		void emit(Program& program, NodeId id, const Layout& layout) const;
+	};
+}
+
+#endif /* SDF_GRAPH_HPP */
@@ -0,0 +1,96 @@
+#ifndef SDF_LIGHTING_HPP
+#define SDF_LIGHTING_HPP
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include "math.hpp"
+#include "profiler.hpp"
+
+namespace sdf {
+	struct LightingSettings {
+		bool shadows = true;
+		// penumbra sharpness, larger values give harder shadows
+		float penumbra = 8.0f;
+		int shadow_steps = 48;
+		float shadow_distance = 20.0f;
+		// shadow rays start this far off the surface along its normal
+		float bias = 0.02f;
+		// edge length of the shadow cache cells per unit of distance from the camera, 0 disables the cache,
+		// about two pixel footprints work well
+		float cache_cell = 0.002f;
+		// scene space position of the camera the cache cells grow from
+		vec3 eye{};
+		bool occlusion = true;
+		float occlusion_radius = 0.15f;
+		float occlusion_strength = 3.0f;
+		// ambient light, scaled by the occlusion
+		float ambient = 0.1f;
+	};
+	
+	// Settings used by every shader, change them only while nothing renders.
+	[[nodiscard]]
+	const LightingSettings& lighting_settings() noexcept;
+	void set_lighting_settings(const LightingSettings& settings) noexcept;
+	
+	struct ShadowResult {
+		float visibility;
+		// how far the ray origin may move while the ray stays fully lit, negative if it is not fully lit
+		float slack;
+	};
+	
+	// Soft shadow from the smallest distance to angle ratio along the ray (Quilez), giving up on the
+	// light once the penumbra is dark or the step budget runs out.
+	template<class F>
+	[[nodiscard]]
+	ShadowResult soft_shadow(F&& distance, const Ray& ray, float far, const LightingSettings& settings) noexcept {
+		float visibility = 1.0f, slack = std::numeric_limits<float>::infinity(), t = 0.0f;
+		int samples = 0;
+		const auto end = [&samples](ShadowResult result) noexcept {
+			thread_evaluations += std::uint64_t(samples);
+			return result;
+		};
+		while (t < far) {
+			if (samples == settings.shadow_steps) return end({ visibility, -1.0f });
+			const float h = distance(ray.origin + ray.direction * t);
+			++samples;
+			if (h < 0.0001f) return end({ 0.0f, -1.0f });
+			// the first sample only sees the surface the ray leaves, which every neighbour leaves as well
+			if (t > 0.0f) {
+				visibility = std::min(visibility, settings.penumbra * h / t);
+				if (visibility < 0.01f) return end({ 0.0f, -1.0f });
+				slack = std::min(slack, h - t / settings.penumbra);
+			}
+			t += h;
+		}
+		return end({ visibility, slack });
+	}
+	
+	// Five samples along the normal, each one darkens by how much closer the surface is than the sample offset.
+	template<class F>
+	[[nodiscard]]
+	float ambient_occlusion(F&& distance, vec3 p, vec3 n, const LightingSettings& settings) noexcept {
+		// taps nearer than the outermost one cannot be closer to the surface than their offset if it is not
+		++thread_evaluations;
+		if (distance(p + n * (0.01f + settings.occlusion_radius)) >= 0.01f + settings.occlusion_radius) return 1.0f;
+		thread_evaluations += 5;
+		float occlusion = 0.0f, weight = 1.0f;
+		for (int i = 0; i < 5; ++i) {
+			const float h = 0.01f + settings.occlusion_radius * float(i) / 4.0f;
+			occlusion += (h - distance(p + n * h)) * weight;
+			weight *= 0.95f;
+		}
+		return std::clamp(1.0f - settings.occlusion_strength * occlusion, 0.0f, 1.0f);
+	}
+	
+	// Per thread memory of fully lit shadow rays, a neighbouring pixel on the same surface can reuse
+	// a ray whose origin lies in the same cell and within its slack. Entries of different scenes never match.
+	[[nodiscard]]
+	bool shadow_cache_lookup(std::uint64_t scene, const Ray& ray) noexcept;
+	void shadow_cache_store(std::uint64_t scene, const Ray& ray, float slack) noexcept;
+	
+	// Box around every surface point whose shadow towards `light` or ambient occlusion may depend on what lies in `box`.
+	[[nodiscard]]
+	Bounds lighting_reach(const Bounds& box, vec3 light, const LightingSettings& settings) noexcept;
+}
+
+#endif /* SDF_LIGHTING_HPP */
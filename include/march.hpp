@@ -0,0 +1,81 @@
+#ifndef SDF_MARCH_HPP
+#define SDF_MARCH_HPP
+#include <cmath>
+#include "math.hpp"
+#include "profiler.hpp"
+
+namespace sdf {
+	struct MarchSettings {
+		// step scale for over-relaxed sphere tracing (Keinert et al.), 1 is plain sphere tracing
+		float relaxation = 1.4f;
+		int max_steps = 256;
+		// hit threshold at the ray origin, grows by pixel_cone per unit of length
+		float epsilon = 0.0001f;
+		float pixel_cone = 0.0f;
+	};
+	
+	enum class MarchEnd {
+		Hit,
+		// left the scene bounds or passed the background distance
+		Sky,
+		// ran out of steps, callers treat this as a hit
+		StepLimit,
+	};
+	
+	struct MarchResult {
+		float t;
+		int steps;
+		MarchEnd end;
+	};
+	
+	// Parameter at which the ray leaves the box, negative if it never enters it.
+	[[nodiscard]]
+	inline float exit_distance(const Bounds& box, const Ray& ray) noexcept {
+		float near = 0.0f, far = std::numeric_limits<float>::infinity();
+		for (int i = 0; i < 3; ++i) {
+			if (ray.direction[i] == 0.0f) {
+				if (ray.origin[i] < box.lower[i] || ray.origin[i] > box.upper[i]) return -1.0f;
+				continue;
+			}
+			const float inv = 1.0f / ray.direction[i];
+			const float t0 = (box.lower[i] - ray.origin[i]) * inv, t1 = (box.upper[i] - ray.origin[i]) * inv;
+			near = std::max(near, std::min(t0, t1));
+			far = std::min(far, std::max(t0, t1));
+		}
+		return near <= far ? far : -1.0f;
+	}
+	
+	// Sphere traces `distance` along the ray from `start`, which callers know to be empty space, up to `far`.
+	// A relaxed step that overshoots the unbounding sphere of the previous point is taken back and the march
+	// continues without relaxation. The hit threshold grows with the distance from the ray origin, not from `start`.
+	template<class F>
+	MarchResult march(F&& distance, const Ray& ray, float far, const MarchSettings& settings, float start = 0.0f) noexcept {
+		if (far <= start) return { start, 0, MarchEnd::Sky };
+		// every step evaluates once, counted when the march ends
+		const auto end = [](MarchResult result) noexcept {
+			thread_evaluations += std::uint64_t(result.steps);
+			return result;
+		};
+		float t = start, omega = settings.relaxation, previous = 0.0f, step = 0.0f;
+		for (int steps = 1; steps <= settings.max_steps; ++steps) {
+			const float d = distance(ray.origin + ray.direction * t);
+			const float radius = std::abs(d);
+			if (omega > 1.0f && radius + previous < step) {
+				t -= step - previous;
+				omega = 1.0f;
+				continue;
+			}
+			if (radius <= settings.epsilon + settings.pixel_cone * t)
+				return end({ t, steps, MarchEnd::Hit });
+			// only the unrelaxed step is known to be empty
+			if (d > 0.0f && t + d >= far)
+				return end({ t + d, steps, MarchEnd::Sky });
+			step = d > 0.0f ? d * omega : d;
+			previous = radius;
+			t += step;
+		}
+		return end({ t, settings.max_steps, MarchEnd::StepLimit });
+	}
+}
+
+#endif /* SDF_MARCH_HPP */
@@ -1,6 +1,7 @@
 #ifndef SDF_MATH_HPP
 #define SDF_MATH_HPP
 #include <glm/glm.hpp>
+#include <limits>
 
 namespace sdf {
 	using glm::vec4;
@@ -16,6 +17,45 @@ namespace sdf {
 		Ray() = default;
 		Ray(vec3 orig, vec3 dir) noexcept : origin(orig), direction(glm::normalize(dir)) {}
 	};
+	// Axis aligned bounding box, the default box is unbounded.
+	struct Bounds {
+		vec3 lower{ -std::numeric_limits<float>::infinity() };
+		vec3 upper{ std::numeric_limits<float>::infinity() };
+		
+		[[nodiscard]]
+		bool finite() const noexcept {
+			return std::isfinite(lower.x) && std::isfinite(lower.y) && std::isfinite(lower.z)
+				&& std::isfinite(upper.x) && std::isfinite(upper.y) && std::isfinite(upper.z);
+		}
+		[[nodiscard]]
+		vec3 center() const noexcept { return (lower + upper) * 0.5f; }
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept {
+			return glm::length(glm::max(glm::max(lower - p, p - upper), vec3{ 0.0f }));
+		}
+	};
+	[[nodiscard]]
+	inline Bounds merge(const Bounds& a, const Bounds& b) noexcept {
+		return { glm::min(a.lower, b.lower), glm::max(a.upper, b.upper) };
+	}
+	[[nodiscard]]
+	inline Bounds intersect(const Bounds& a, const Bounds& b) noexcept {
+		return { glm::max(a.lower, b.lower), glm::min(a.upper, b.upper) };
+	}
+	// Box around the images of the corners of b under f.
+	template<class F>
+	[[nodiscard]]
+	Bounds transform_bounds(const Bounds& b, F f) noexcept {
+		if (!b.finite()) return {};
+		Bounds r{ vec3{ std::numeric_limits<float>::infinity() }, vec3{ -std::numeric_limits<float>::infinity() } };
+		for (int i = 0; i < 8; ++i) {
+			const vec3 corner{ i & 1 ? b.upper.x : b.lower.x, i & 2 ? b.upper.y : b.lower.y, i & 4 ? b.upper.z : b.lower.z };
+			const vec3 q = f(corner);
+			r = { glm::min(r.lower, q), glm::max(r.upper, q) };
+		}
+		return r;
+	}
+	
 	constexpr Color alpha_blend(Color c1, Color c2) {
 		return (1.0f - c2.w) * c1 + c2.w * c2;
 	}
@@ -2,20 +2,47 @@
 #define SDF_OBJECT_HPP
 #include <utility>
 #include <memory>
+#include <optional>
+#include <span>
+#include <vector>
 #include "shader.hpp"
 #include "math.hpp"
 
 namespace sdf {
+	class Program;
+	
 	class Object {
 	public:
 		virtual ~Object() = default;
 		virtual std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const = 0;
+		virtual void compile(Program& program) const = 0;
 		[[nodiscard]]
 		virtual vec3 normal(vec3 p) const noexcept;
 		[[nodiscard]]
+		virtual vec3 gradient(vec3 p) const noexcept;
+		[[nodiscard]]
 		virtual std::pair<vec3, vec3> sampleDirectionalLight() const noexcept;
+		// Visibility in [0, 1] of the directional light towards `light` from the surface point p with normal n.
+		[[nodiscard]]
+		virtual float shadow(vec3 p, vec3 n, vec3 light) const noexcept;
+		// Visibility in [0, 1] of ambient light at the surface point p with normal n.
+		[[nodiscard]]
+		virtual float occlusion(vec3 p, vec3 n) const noexcept;
 		[[nodiscard]]
 		virtual vec3 center() const noexcept;
+		[[nodiscard]]
+		virtual Bounds bounds() const noexcept;
+		// Box around everything below the object that update() changed since the last commit_changes(),
+		// in the space of bounds(), nullopt if nothing changed. Endless repetitions make it unbounded.
+		[[nodiscard]]
+		virtual std::optional<Bounds> changes() const;
+		// Forgets the changes of the object and of everything below it.
+		virtual void commit_changes() noexcept;
+	protected:
+		// Marks the space the object covered before an update and covers now as changed.
+		void touch(const Bounds& before) noexcept;
+	private:
+		std::optional<Bounds> changed{};
 	};
 	
 	
@@ -27,6 +54,11 @@ namespace sdf {
 		
 		[[nodiscard]]
 		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
 	};
 	class Cube : public Object {
 	public:
@@ -36,6 +68,11 @@ namespace sdf {
 		
 		[[nodiscard]]
 		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
 	};
 	
 	
@@ -50,8 +87,17 @@ namespace sdf {
 		
 		[[nodiscard]]
 		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
 		[[nodiscard]]
 		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+		void update(vec3 translation);
 	};
 	class RotationX : public Object {
 	private:
@@ -65,8 +111,16 @@ namespace sdf {
 		
 		[[nodiscard]]
 		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
 		[[nodiscard]]
 		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
 		void update(float rotation);
 	};
 	class RotationY : public Object {
@@ -81,8 +135,16 @@ namespace sdf {
 		
 		[[nodiscard]]
 		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
 		[[nodiscard]]
 		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
 		void update(float rotation);
 	};
 	
@@ -95,8 +157,16 @@ namespace sdf {
 		
 		[[nodiscard]]
 		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
 		[[nodiscard]]
 		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
 	};
 	class Intersection : public Object {
 	public:
@@ -107,8 +177,16 @@ namespace sdf {
 		
 		[[nodiscard]]
 		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
 		[[nodiscard]]
 		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
 	};
 	class Subtraction : public Object {
 	public:
@@ -119,9 +197,199 @@ namespace sdf {
 		
 		[[nodiscard]]
 		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+	};
+	
+	// Invertible linear map plus offset with one precomputed matrix, the object is evaluated at (dot(x, p), dot(y, p), dot(z, p)) + offset.
+	// Maps that stretch space scale the object's distance by the inverse of the largest stretch, which keeps it a lower bound.
+	class Affine : public Object {
+	public:
+		std::shared_ptr<Object> object;
+		vec3 x, y, z, offset;
+		// 1 for rigid maps
+		float scale;
+		
+		// Throws std::invalid_argument for singular matrices.
+		Affine(const std::shared_ptr<Object>& obj, vec3 x, vec3 y, vec3 z, vec3 offset);
+		
+		// Collapses a chain of at least two Translation, RotationX, RotationY and Affine nodes into one Affine node.
+		[[nodiscard]]
+		static std::shared_ptr<Object> fuse(const std::shared_ptr<Object>& object);
+		[[nodiscard]]
+		vec3 local(vec3 p) const noexcept { return vec3{ glm::dot(x, p), glm::dot(y, p), glm::dot(z, p) } + offset; }
+		// Inverse of local().
+		[[nodiscard]]
+		vec3 world(vec3 q) const noexcept { return inverse * (q - offset); }
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
 		[[nodiscard]]
 		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+	private:
+		glm::mat3 inverse;
 	};
+	
+	// Infinite copies of the object spaced by `period` along each axis with a non-zero period,
+	// at most `limit` cells to each side of the original. Each copy must fit in its cell.
+	class Repetition : public Object {
+	public:
+		std::shared_ptr<Object> object;
+		vec3 period, limit;
+		
+		Repetition(const std::shared_ptr<Object>& obj, vec3 period, vec3 limit = vec3{ std::numeric_limits<float>::infinity() })
+				: object(obj), period(period), limit(limit) {}
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+	};
+	// Mirrors the positive half of the object onto the negative half of every flagged axis.
+	class Mirror : public Object {
+	public:
+		std::shared_ptr<Object> object;
+		bool axes[3];
+		
+		Mirror(const std::shared_ptr<Object>& obj, bool x, bool y, bool z)
+				: object(obj), axes{ x, y, z } {}
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+	};
+	
+	// Smooth CSG, rounding the seam between the two objects over a distance of about k.
+	class SmoothUnion : public Object {
+	public:
+		std::shared_ptr<Object> obj1, obj2;
+		float k;
+		
+		SmoothUnion(const std::shared_ptr<Object>& obj1, const std::shared_ptr<Object>& obj2, float k)
+				: obj1(obj1), obj2(obj2), k(k) {}
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+	};
+	class SmoothIntersection : public Object {
+	public:
+		std::shared_ptr<Object> obj1, obj2;
+		float k;
+		
+		SmoothIntersection(const std::shared_ptr<Object>& obj1, const std::shared_ptr<Object>& obj2, float k)
+				: obj1(obj1), obj2(obj2), k(k) {}
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+	};
+	class SmoothSubtraction : public Object {
+	public:
+		std::shared_ptr<Object> obj1, obj2;
+		float k;
+		
+		SmoothSubtraction(const std::shared_ptr<Object>& obj1, const std::shared_ptr<Object>& obj2, float k)
+				: obj1(obj1), obj2(obj2), k(k) {}
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+	};
+	
+	// One object repeated at every offset of a table, compiled into a single hierarchy of culled blocks
+	// instead of a Translation and a Union node per copy.
+	class Instances : public Object {
+	public:
+		std::shared_ptr<Object> object;
+		std::vector<vec3> offsets;
+		
+		Instances(const std::shared_ptr<Object>& obj, std::vector<vec3> offsets)
+				: object(obj), offsets(std::move(offsets)) {}
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& program) const override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		vec3 center() const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override;
+		[[nodiscard]]
+		std::optional<Bounds> changes() const override;
+		void commit_changes() noexcept override;
+	};
+	
+	// Box around a child's box b as seen from its parent, shared with the scene graph, which has no objects to ask.
+	[[nodiscard]]
+	Bounds rotate_x_bounds(const Bounds& b, float sinr, float cosr) noexcept;
+	[[nodiscard]]
+	Bounds rotate_y_bounds(const Bounds& b, float sinr, float cosr) noexcept;
+	[[nodiscard]]
+	Bounds affine_bounds(const Affine& affine, const Bounds& b) noexcept;
+	[[nodiscard]]
+	Bounds repeat_bounds(Bounds b, vec3 period, vec3 limit) noexcept;
+	[[nodiscard]]
+	Bounds mirror_bounds(Bounds b, const bool* axes) noexcept;
+	[[nodiscard]]
+	Bounds instance_bounds(const Bounds& b, std::span<const vec3> offsets) noexcept;
 }
 
 #endif /* SDF_OBJECT_HPP */
@@ -0,0 +1,33 @@
+#ifndef SDF_PACKET_HPP
+#define SDF_PACKET_HPP
+#include <cstdint>
+#include <cstddef>
+#include "bytecode.hpp"
+#include "march.hpp"
+
+namespace sdf {
+	constexpr std::size_t max_packet_width = 8;
+	
+	enum class PacketIsa {
+		Scalar,
+		SSE,
+		AVX2,
+	};
+	
+	// SoA ray storage for one packet, lanes past `count` are ignored.
+	// Lanes march from `start` up to `far` and report the parameter `t` they stopped at and the steps they took.
+	struct alignas(32) RayPacket {
+		float ox[max_packet_width], oy[max_packet_width], oz[max_packet_width];
+		float dx[max_packet_width], dy[max_packet_width], dz[max_packet_width];
+		float start[max_packet_width], far[max_packet_width], t[max_packet_width], steps[max_packet_width];
+		std::size_t count;
+		std::uint32_t hit;
+	};
+	
+	void march_sse(const Instruction* code, std::size_t size, RayPacket& packet, const MarchSettings& settings) noexcept;
+	void distance_sse(const Instruction* code, std::size_t size, const float* x, const float* y, const float* z, float* out) noexcept;
+	void march_avx2(const Instruction* code, std::size_t size, RayPacket& packet, const MarchSettings& settings) noexcept;
+	void distance_avx2(const Instruction* code, std::size_t size, const float* x, const float* y, const float* z, float* out) noexcept;
+}
+
+#endif /* SDF_PACKET_HPP */
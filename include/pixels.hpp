@@ -0,0 +1,21 @@
+#ifndef SDF_PIXELS_HPP
+#define SDF_PIXELS_HPP
+#include <cstddef>
+#include <cstdint>
+#include "math.hpp"
+
+namespace sdf {
+	struct PixelEncoding {
+		// encode the color channels with the sRGB transfer function
+		bool srgb = false;
+		// replace rounding with a 4x4 ordered dither
+		bool dither = false;
+	};
+	
+	// Clamps and quantizes `count` colors of the row starting at pixel (x, y), which selects the dither pattern.
+	void encode_rgba(const Color* in, std::uint8_t* out, std::size_t count, int x, int y, PixelEncoding encoding = {}) noexcept;
+	// Same as encode_rgba() but packs each pixel into 0xAARRGGBB, the layout of SDL_PIXELFORMAT_RGB888 and ARGB8888.
+	void encode_argb(const Color* in, std::uint32_t* out, std::size_t count, int x, int y, PixelEncoding encoding = {}) noexcept;
+}
+
+#endif /* SDF_PIXELS_HPP */
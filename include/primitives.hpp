@@ -0,0 +1,78 @@
+#ifndef SDF_PRIMITIVES_HPP
+#define SDF_PRIMITIVES_HPP
+#include <algorithm>
+#include <cmath>
+#include "math.hpp"
+
+namespace sdf {
+	[[nodiscard]]
+	inline float sphere_distance(vec3 p, float radius) noexcept {
+		return glm::length(p) - radius;
+	}
+	[[nodiscard]]
+	inline vec3 sphere_gradient(vec3 p) noexcept {
+		const float len = glm::length(p);
+		return len > 0.0f ? p / len : vec3{ 0.0f, 1.0f, 0.0f };
+	}
+	
+	[[nodiscard]]
+	inline float cube_distance(vec3 p, float a) noexcept {
+		const float dx = std::abs(p.x) - a / 2, dx0 = std::max(0.0f, dx);
+		const float dy = std::abs(p.y) - a / 2, dy0 = std::max(0.0f, dy);
+		const float dz = std::abs(p.z) - a / 2, dz0 = std::max(0.0f, dz);
+		
+		const float inner = std::min(0.0f, std::max({ dx, dy, dz }));
+		const float outer = std::sqrt(dx0 * dx0 + dy0 * dy0 + dz0 * dz0);
+		return inner + outer;
+	}
+	[[nodiscard]]
+	inline vec3 cube_gradient(vec3 p, float a) noexcept {
+		const vec3 s{ p.x < 0.0f ? -1.0f : 1.0f, p.y < 0.0f ? -1.0f : 1.0f, p.z < 0.0f ? -1.0f : 1.0f };
+		const vec3 d = glm::abs(p) - vec3{ a / 2 };
+		const vec3 outside = glm::max(d, vec3{ 0.0f });
+		const float len = glm::length(outside);
+		if (len > 0.0f) return outside / len * s;
+		if (d.x >= d.y && d.x >= d.z) return { s.x, 0.0f, 0.0f };
+		if (d.y >= d.z) return { 0.0f, s.y, 0.0f };
+		return { 0.0f, 0.0f, s.z };
+	}
+	
+	// Moves p into the cell around the origin of a grid with the given period, limited to `limit` cells to each side.
+	// Axes with a period of 0 are not repeated. Rounding is to nearest even, like the packet kernels.
+	[[nodiscard]]
+	inline vec3 repeat_point(vec3 p, vec3 period, vec3 limit) noexcept {
+		for (int i = 0; i < 3; ++i) {
+			if (period[i] == 0.0f) continue;
+			const float inv = 1.0f / period[i];
+			p[i] -= period[i] * std::clamp(std::nearbyint(p[i] * inv), -limit[i], limit[i]);
+		}
+		return p;
+	}
+	
+	// Blend weight of the polynomial smooth minimum (Quilez) with radius k, 0 where the arguments differ by k or more.
+	// The blend subtracts blend * blend * k / 4 from the minimum, the gradient takes blend / 2 of the other argument.
+	[[nodiscard]]
+	inline float smooth_blend(float a, float b, float k) noexcept {
+		return std::max(k - std::abs(a - b), 0.0f) * (1.0f / k);
+	}
+	[[nodiscard]]
+	inline float smooth_min(float a, float b, float k) noexcept {
+		const float h = smooth_blend(a, b, k);
+		return std::min(a, b) - h * h * (k * 0.25f);
+	}
+	[[nodiscard]]
+	inline float smooth_max(float a, float b, float k) noexcept {
+		const float h = smooth_blend(a, b, k);
+		return std::max(a, b) + h * h * (k * 0.25f);
+	}
+	
+	// Gradient estimate from four samples on the corners of a tetrahedron.
+	template<class F>
+	[[nodiscard]]
+	vec3 tetrahedral_gradient(F&& f, vec3 p, float h = 0.001f) {
+		const vec3 a{ 1.0f, -1.0f, -1.0f }, b{ -1.0f, -1.0f, 1.0f }, c{ -1.0f, 1.0f, -1.0f }, d{ 1.0f, 1.0f, 1.0f };
+		return (a * f(p + a * h) + b * f(p + b * h) + c * f(p + c * h) + d * f(p + d * h)) / (4.0f * h);
+	}
+}
+
+#endif /* SDF_PRIMITIVES_HPP */
@@ -0,0 +1,84 @@
+#ifndef SDF_PROFILER_HPP
+#define SDF_PROFILER_HPP
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace sdf {
+	enum class Stage : std::uint8_t {
+		Frame,
+		// camera rays and their start depths
+		RayGen,
+		March,
+		Shade,
+		// converting colors into the output image
+		Blit,
+		Present,
+	};
+	constexpr std::size_t stage_count = 6;
+	[[nodiscard]]
+	const char* stage_name(Stage stage) noexcept;
+	
+	// SDF evaluations of the calling thread. The march, shadow and occlusion loops add their samples when they finish,
+	// packets a point per lane and step, and shading adds one each for a hit's material and normal.
+	inline thread_local std::uint64_t thread_evaluations = 0;
+	// Adds the calling thread's evaluations since its last flush to the total of all threads, call at the end of every tile.
+	void flush_evaluations() noexcept;
+	// Evaluations flushed by all threads so far, including the calling thread's.
+	[[nodiscard]]
+	std::uint64_t total_evaluations() noexcept;
+	
+	struct PixelCost {
+		std::uint32_t steps = 0;
+		// march steps plus the evaluations of shading the hit
+		std::uint32_t evaluations = 0;
+	};
+	
+	struct StageTotals {
+		double seconds = 0.0;
+		std::uint64_t evaluations = 0;
+		std::size_t count = 0;
+	};
+	
+	// While profiling every ProfileScope records an event on its thread, events are kept until reset_profile().
+	// Toggle, reset, read and write only while nothing renders.
+	void set_profiling(bool enabled) noexcept;
+	[[nodiscard]]
+	bool profiling() noexcept;
+	// Events recorded from now on belong to frame `frame`.
+	void profile_frame(std::uint64_t frame) noexcept;
+	void reset_profile() noexcept;
+	// Time and evaluations of every stage, summed over the threads.
+	[[nodiscard]]
+	std::array<StageTotals, stage_count> profile_totals();
+	// Logs the totals of the stages that recorded events.
+	void log_profile();
+	// Writes the events in the Chrome trace event format (chrome://tracing, Perfetto), returns false if the file cannot be written.
+	bool write_chrome_trace(const std::string& path);
+	
+	[[nodiscard]]
+	std::int64_t profile_clock() noexcept;
+	void record_stage(Stage stage, std::int64_t begin, std::uint64_t evaluations);
+	
+	// Times the enclosing block as one event of the stage, costs a flag check while not profiling.
+	// Frames count the evaluations of every thread's tiles, the other stages those of their own thread.
+	class ProfileScope {
+	public:
+		explicit ProfileScope(Stage stage) noexcept
+				: stage(stage), begin(profiling() ? profile_clock() : -1), evaluations(count()) {}
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+		~ProfileScope() {
+			if (begin >= 0) record_stage(stage, begin, count() - evaluations);
+		}
+	private:
+		Stage stage;
+		std::int64_t begin;
+		std::uint64_t evaluations;
+		
+		[[nodiscard]]
+		std::uint64_t count() const noexcept { return stage == Stage::Frame ? total_evaluations() : thread_evaluations; }
+	};
+}
+
+#endif /* SDF_PROFILER_HPP */
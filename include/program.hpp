@@ -0,0 +1,86 @@
+#ifndef SDF_PROGRAM_HPP
+#define SDF_PROGRAM_HPP
+#include <functional>
+#include <utility>
+#include <memory>
+#include <span>
+#include <vector>
+#include "bytecode.hpp"
+#include "object.hpp"
+
+namespace sdf {
+	// Unions with at least this many members are compiled into a bounding volume hierarchy.
+	constexpr std::size_t min_bvh_members = 3;
+	
+	class Program {
+	public:
+		struct Sample {
+			float distance;
+			std::uint32_t material = 0;
+			vec3 gradient{};
+		};
+		// Appends the code of one object or of member i of a union, which leaves its distance on the stack.
+		using Emitter = std::function<void(Program&)>;
+		using MemberEmitter = std::function<void(Program&, std::size_t i)>;
+		
+		std::vector<Instruction> code;
+		std::vector<std::shared_ptr<Shader>> materials;
+		// bounds of the compiled object, rays leaving them cannot hit anything
+		Bounds bounds{};
+		
+		[[nodiscard]]
+		static Program compile(const Object& object);
+		// Checks code emitted without compile(), throws std::logic_error if it is unbalanced
+		// and std::length_error if it needs more than the interpreter's stack.
+		void validate() const;
+		
+		void emit(Opcode op, float a = 0.0f, float b = 0.0f, float c = 0.0f, std::uint32_t material = 0);
+		[[nodiscard]]
+		std::uint32_t material(const std::shared_ptr<Shader>& shader);
+		void emit_union(std::vector<const Object*> members);
+		// The same for members given by their bounds and code.
+		void emit_union(const std::vector<Bounds>& bounds, const MemberEmitter& member);
+		// Compiles the object once and copies its code to every offset.
+		void emit_instances(const Object& object, std::span<const vec3> offsets);
+		void emit_instances(const Emitter& object, const Bounds& bounds, std::span<const vec3> offsets);
+		
+		[[nodiscard]]
+		float distance(vec3 p) const noexcept;
+		[[nodiscard]]
+		std::pair<float, std::uint32_t> evaluate(vec3 p) const noexcept;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept;
+		[[nodiscard]]
+		Sample sample(vec3 p) const noexcept;
+	};
+	
+	class CompiledObject : public Object {
+	public:
+		Program program;
+		// unique per constructed object, keys caches that must not outlive the scene
+		std::uint64_t serial;
+		
+		explicit CompiledObject(Program program) noexcept : program(std::move(program)), serial(next_serial()) {}
+		explicit CompiledObject(const Object& object) : program(Program::compile(object)), serial(next_serial()) {}
+		
+		[[nodiscard]]
+		std::pair<float, std::shared_ptr<Shader>> operator()(const vec3& p) const override;
+		void compile(Program& prog) const override;
+		[[nodiscard]]
+		vec3 normal(vec3 p) const noexcept override;
+		[[nodiscard]]
+		vec3 gradient(vec3 p) const noexcept override;
+		[[nodiscard]]
+		Bounds bounds() const noexcept override { return program.bounds; }
+		// Reuses fully lit shadow rays of neighbouring surface points.
+		[[nodiscard]]
+		float shadow(vec3 p, vec3 n, vec3 light) const noexcept override;
+		[[nodiscard]]
+		float occlusion(vec3 p, vec3 n) const noexcept override;
+	private:
+		[[nodiscard]]
+		static std::uint64_t next_serial() noexcept;
+	};
+}
+
+#endif /* SDF_PROGRAM_HPP */
@@ -1,9 +1,26 @@
 #ifndef SDF_RAYTRACER_HPP
 #define SDF_RAYTRACER_HPP
 #include "object.hpp"
+#include "program.hpp"
+#include "packet.hpp"
+#include "march.hpp"
 #include "math.hpp"
 
 namespace sdf {
+	class Reprojection;
+	struct PixelCost;
+	
+	// pixels per side of the tiles the cone pre-pass marches
+	constexpr int cone_tile = 8;
+	
+	// Pixels [x0, x1) x [y0, y1) of an image.
+	struct PixelRect {
+		int x0, y0, x1, y1;
+		
+		[[nodiscard]]
+		bool empty() const noexcept { return x0 >= x1 || y0 >= y1; }
+	};
+	
 	struct PerspectiveCamera {
 		float focalLength;
 		int sensorWidth;
@@ -12,13 +29,74 @@ namespace sdf {
 		explicit PerspectiveCamera(float focalLength = 50.0f, int sensorWidth = 32, int sensorHeight = 18) noexcept
 				: focalLength(focalLength), sensorWidth(sensorWidth), sensorHeight(sensorHeight) {}
 		
+		// Places the camera at -position, turned by the pitch (x) and then the yaw (y) in radians.
+		void pose(vec3 position, vec2 rotation) noexcept;
+		[[nodiscard]]
+		vec3 position() const noexcept { return -eye; }
+		[[nodiscard]]
+		vec2 rotation() const noexcept { return angles; }
+		// Camera origin in scene space.
+		[[nodiscard]]
+		vec3 origin() const noexcept { return eye; }
+		
+		// Scene space ray through the point (x, y) of the image, both in [0, 1].
 		[[nodiscard]]
 		Ray project(float x, float y) const noexcept;
+		// Maps a scene space point into the space of the camera, which looks down -z.
+		[[nodiscard]]
+		vec3 to_camera(vec3 p) const noexcept;
+		// Pixels of a width x height image the box may cover, the whole image if it reaches behind the camera.
+		[[nodiscard]]
+		PixelRect screen_bounds(const Bounds& box, int width, int height) const noexcept;
+		// Approximate angle covered by one pixel of an image `width` pixels wide, usable as MarchSettings::pixel_cone.
+		[[nodiscard]]
+		float footprint(int width) const noexcept;
+	private:
+		vec3 eye{};
+		vec2 angles{};
+		// camera space axes in scene space
+		vec3 axes[3]{ { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
 	};
 	
 	
+	[[nodiscard]]
+	Color project_background(const Ray& ray) noexcept;
+	// Settings used by every tracer, change them only while nothing renders.
+	[[nodiscard]]
+	const MarchSettings& march_settings() noexcept;
+	void set_march_settings(const MarchSettings& settings) noexcept;
+	// Marches the program within its bounds and bgDist.
+	[[nodiscard]]
+	MarchResult march(const Program& program, const Ray& ray, float bgDist = 1000.0f, float start = 0.0f) noexcept;
+	
 	[[nodiscard]]
 	Color trace(const std::shared_ptr<Object>& object, Ray ray, float bgDist = 1000.0f);
+	[[nodiscard]]
+	Color trace(const std::shared_ptr<CompiledObject>& object, Ray ray, float bgDist = 1000.0f, float* depth = nullptr, std::uint32_t* material = nullptr);
+	
+	[[nodiscard]]
+	PacketIsa packet_isa() noexcept;
+	PacketIsa set_packet_isa(PacketIsa isa) noexcept;
+	[[nodiscard]]
+	std::size_t packet_width(PacketIsa isa) noexcept;
+	// Material reported for rays that hit nothing.
+	constexpr std::uint32_t no_material = UINT32_MAX;
+	// Optionally reports the distance from each ray origin to its hit, infinity for misses, the material hit and what the ray cost.
+	// All rays are marched before any of them is shaded.
+	// Rays with `starts` begin marching at those parameters, which must lie in empty space.
+	void trace_packet(const std::shared_ptr<CompiledObject>& object, const Ray* rays, std::size_t count, Color* out, float bgDist = 1000.0f,
+		float* depth = nullptr, std::uint32_t* material = nullptr, PixelCost* cost = nullptr, const float* starts = nullptr);
+	
+	// Marches a cone around `axis` whose rays deviate from it by at most `spread` per unit of length,
+	// returns a depth up to which no ray of the cone can hit anything.
+	[[nodiscard]]
+	float cone_march(const Program& program, const Ray& axis, float spread, float bgDist = 1000.0f) noexcept;
+	// Traces pixels [xoff, xoff + xsize) x [yoff, yoff + ysize) of a width x height image into `out`, row by row.
+	// Every cone_tile sized tile starts at its cone depth, or the reprojected depth if that is further.
+	// With a checkerboard parity of 0 or 1 only pixels with (x + y) % 2 == parity are traced, the others are left as they are.
+	void trace_region(const std::shared_ptr<CompiledObject>& object, const PerspectiveCamera& camera, int width, int height,
+		int xoff, int yoff, int xsize, int ysize, Color* out, Reprojection* temporal = nullptr, int checkerboard = -1, float bgDist = 1000.0f,
+		float* depth = nullptr, std::uint32_t* material = nullptr, PixelCost* cost = nullptr);
 }
 
 #endif /* SDF_RAYTRACER_HPP */
@@ -0,0 +1,96 @@
+#ifndef SDF_REGION_HPP
+#define SDF_REGION_HPP
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "math.hpp"
+
+namespace sdf {
+	struct PerspectiveCamera;
+	class CompiledObject;
+	class Reprojection;
+	
+	// Running sum of jittered samples per pixel, refined by one sample per pass while the view stays the same.
+	class Accumulation {
+	public:
+		Accumulation(int width, int height);
+		
+		[[nodiscard]]
+		int width() const noexcept { return w; }
+		[[nodiscard]]
+		int height() const noexcept { return h; }
+		// Number of completed passes since the last reset.
+		[[nodiscard]]
+		std::uint32_t passes() const noexcept { return pass; }
+		[[nodiscard]]
+		std::uint32_t samples(int x, int y) const noexcept { return pass ? counts[std::size_t(y) * w + x] : 0; }
+		
+		// Drops every sample, call whenever the view changes.
+		void reset() noexcept { pass = 0; }
+		// Drops the samples of pixels [x0, x1) x [y0, y1) only, regions starting on such a pixel render like a first pass.
+		void reset(int x0, int y0, int x1, int y1) noexcept;
+		// Call once every pixel of a frame has been rendered.
+		void advance() noexcept { ++pass; }
+		// Adds `count` samples summing up to `sum` to pixel (x, y) and returns its new mean.
+		Color add(int x, int y, Color sum, std::uint32_t count) noexcept;
+	private:
+		int w, h;
+		std::uint32_t pass = 0;
+		std::vector<Color> sums;
+		std::vector<std::uint32_t> counts;
+	};
+	
+	// Last rendered color of every pixel, checkerboard frames fill the pixels they skip from it instead of from their neighbours.
+	class FrameHistory {
+	public:
+		FrameHistory(int width, int height);
+		
+		[[nodiscard]]
+		bool known(int x, int y) const noexcept { return valid[std::size_t(y) * w + x]; }
+		[[nodiscard]]
+		Color color(int x, int y) const noexcept { return colors[std::size_t(y) * w + x]; }
+		void store(int x, int y, Color color) noexcept;
+		
+		// Forgets every pixel, call whenever the view changes.
+		void reset() noexcept;
+		// Forgets pixels [x0, x1) x [y0, y1) only, for regions whose content changed.
+		void reset(int x0, int y0, int x1, int y1) noexcept;
+	private:
+		int w, h;
+		std::vector<Color> colors;
+		std::vector<std::uint8_t> valid;
+	};
+	
+	// Optional per-frame state of the region renderers.
+	struct RenderOptions {
+		Reprojection* temporal = nullptr;
+		// parity of the traced pixels, -1 traces all of them
+		int checkerboard = -1;
+		// extra jittered samples for pixels on an edge, 0 disables anti-aliasing
+		int edge_samples = 0;
+		// largest channel difference between neighbouring pixels that still is no edge
+		float edge_contrast = 0.1f;
+		// same for the depth difference relative to the nearer pixel
+		float edge_depth = 0.05f;
+		// ignored by checkerboard frames
+		Accumulation* accumulation = nullptr;
+		// remembers every color rendered, checkerboard frames reuse it for the pixels they skip
+		FrameHistory* history = nullptr;
+		float bgDist = 1000.0f;
+		// shows the SDF evaluations of every pixel instead of its color, this many are red, 0 shows colors
+		float heatmap = 0.0f;
+	};
+	
+	// Renders a region of a width x height image into `out`, whose rows are xsize colors wide.
+	// Pixels that differ from a neighbour in material, depth or color get edge_samples extra jittered rays.
+	// Once the accumulation holds samples of the region's first pixel every pixel only adds one more jittered sample to it and shows the mean.
+	// Heatmaps skip anti-aliasing and accumulation.
+	// Blue through green and yellow to red for a cost in [0, 1].
+	[[nodiscard]]
+	Color heat_color(float cost) noexcept;
+	
+	void render_region(const std::shared_ptr<CompiledObject>& object, const PerspectiveCamera& camera, int width, int height,
+		int xoff, int yoff, int xsize, int ysize, Color* out, const RenderOptions& options = {});
+}
+
+#endif /* SDF_REGION_HPP */
@@ -0,0 +1,43 @@
+#ifndef SDF_REPROJECTION_HPP
+#define SDF_REPROJECTION_HPP
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "math.hpp"
+
+namespace sdf {
+	struct PerspectiveCamera;
+	class TaskPool;
+	
+	// Remembers last frame's hit points and turns them into conservative start depths for the next frame.
+	class Reprojection {
+	public:
+		// fraction of the reprojected depth at which marching starts
+		float safety = 0.9f;
+		
+		Reprojection(int width, int height);
+		
+		[[nodiscard]]
+		int width() const noexcept { return w; }
+		[[nodiscard]]
+		int height() const noexcept { return h; }
+		
+		// Reprojects the hits of the previous frame into the new camera pose, call before rendering a frame.
+		void begin_frame(const PerspectiveCamera& camera, TaskPool& pool);
+		
+		// Depth at which the camera ray of pixel (x, y) may start, callers still have to reject starts inside geometry.
+		[[nodiscard]]
+		float start(int x, int y) const noexcept { return starts[std::size_t(y) * w + x]; }
+		// Makes pixels [x0, x1) x [y0, y1) start at the camera this frame, for regions whose content changed.
+		void discard(int x0, int y0, int x1, int y1) noexcept;
+		// Records the hit `depth` along a camera ray, infinity for a miss.
+		void store(int x, int y, const Ray& ray, float depth) noexcept;
+	private:
+		int w, h;
+		std::vector<vec3> hits;
+		std::vector<std::atomic_uint32_t> splats;
+		std::vector<float> starts;
+	};
+}
+
+#endif /* SDF_REPROJECTION_HPP */
@@ -0,0 +1,57 @@
+#ifndef SDF_SCENE_HPP
+#define SDF_SCENE_HPP
+#include <memory>
+#include <string>
+#include <string_view>
+#include "object.hpp"
+#include "graph.hpp"
+#include "fixed.hpp"
+#include "shader.hpp"
+
+namespace sdf {
+	[[nodiscard]]
+	SceneGraph demo_scene_graph();
+	[[nodiscard]]
+	std::shared_ptr<Object> demo_scene();
+	// The demo scene as a fixed scene, its type spells out the whole tree.
+	[[nodiscard]]
+	inline auto fixed_demo_scene() {
+		const fixed::Cube cube{ 1.0f };
+		return make_fixed(fixed::Union{
+			fixed::Translate{ cube, { 1.8f, 0.0f, -10.0f } }, fixed::Translate{ cube, { 0.0f, 0.0f, -10.0f } },
+			fixed::Translate{ cube, { 1.8f, 1.0f, -10.0f } }, fixed::Translate{ cube, { 0.0f, 1.0f, -10.0f } },
+		}, { std::make_shared<ShaderLambertian>(Color{ 0.1f, 0.1f, 0.9f, 1.0f }) });
+	}
+	
+	// Scene descriptions are whitespace separated tokens, `#` starts a comment that runs to the end of the line.
+	//   material NAME lambertian|constant R G B      defines a shader
+	//   define NAME EXPR                             names an object for reuse
+	//   scene EXPR                                   the object to render, given exactly once
+	// where EXPR is one of
+	//   sphere RADIUS MATERIAL | cube SIZE MATERIAL | NAME
+	//   translate X Y Z EXPR | rotate_x RADIANS EXPR | rotate_y RADIANS EXPR
+	//   scale S EXPR                                 grows the object by S around the origin
+	//   affine M00 M01 M02 M10 M11 M12 M20 M21 M22 X Y Z EXPR
+	//                                                moves each point p of the object to M p + (X, Y, Z), M row by row
+	//   union { EXPR... } | intersection EXPR EXPR | subtraction EXPR EXPR
+	//   instances EXPR { X Y Z... }                  one copy at every offset
+	//   array NX NY NZ DX DY DZ EXPR                 copies at (i * DX, j * DY, k * DZ) for i < NX, j < NY, k < NZ
+	//   repeat DX DY DZ EXPR                         endless copies every DX, DY, DZ, a step of 0 leaves the axis alone
+	//   repeat_limited DX DY DZ NX NY NZ EXPR        the same with at most NX, NY, NZ copies to each side
+	//   mirror X Y Z EXPR                            reflects the positive half across every axis flagged 1
+	//   smooth_union K { EXPR... } | smooth_intersection K EXPR EXPR | smooth_subtraction K EXPR EXPR
+	//                                                blend the seams over a distance of about K
+	// Nested translations, rotations and affine maps are fused into one matrix.
+	// Malformed descriptions throw std::runtime_error naming the line.
+	[[nodiscard]]
+	SceneGraph parse_scene_graph(std::string_view text);
+	[[nodiscard]]
+	SceneGraph load_scene_graph(const std::string& path);
+	// Frozen scene graphs of a description.
+	[[nodiscard]]
+	std::shared_ptr<Object> parse_scene(std::string_view text);
+	[[nodiscard]]
+	std::shared_ptr<Object> load_scene(const std::string& path);
+}
+
+#endif /* SDF_SCENE_HPP */
@@ -0,0 +1,97 @@
+#ifndef SDF_SCHEDULER_HPP
+#define SDF_SCHEDULER_HPP
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <optional>
+
+namespace sdf {
+	class TaskPool {
+	public:
+		using Task = std::function<void(std::size_t)>;
+		
+		explicit TaskPool(std::size_t threads = default_threads());
+		TaskPool(const TaskPool&) = delete;
+		TaskPool& operator=(const TaskPool&) = delete;
+		~TaskPool();
+		
+		[[nodiscard]]
+		static std::size_t default_threads() noexcept;
+		[[nodiscard]]
+		std::size_t size() const noexcept { return threads.size(); }
+		
+		// Runs task(i) for every i in [0, count) and returns once all of them have finished.
+		void run(std::size_t count, const Task& task);
+	private:
+		struct Job {
+			const Task* task;
+			std::size_t index;
+		};
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+		
+		std::vector<std::thread> threads;
+		std::unique_ptr<Queue[]> queues;
+		std::mutex mutex;
+		std::condition_variable wake, done;
+		std::atomic_size_t remaining = 0;
+		std::size_t generation = 0;
+		bool stopping = false;
+		
+		bool next(std::size_t id, Job& job);
+		void worker(std::size_t id);
+	};
+	
+	// Queue between threads that holds at most `capacity` items, producers wait while it is full.
+	template<class T>
+	class BoundedQueue {
+	public:
+		explicit BoundedQueue(std::size_t capacity) : capacity(std::max<std::size_t>(capacity, 1)) {}
+		
+		void push(T item) {
+			{
+				std::unique_lock lock{ mutex };
+				not_full.wait(lock, [this] { return items.size() < capacity; });
+				items.push_back(std::move(item));
+			}
+			not_empty.notify_one();
+		}
+		// Waits for the next item, nullopt once the queue is closed and empty.
+		std::optional<T> pop() {
+			std::optional<T> item{};
+			{
+				std::unique_lock lock{ mutex };
+				not_empty.wait(lock, [this] { return !items.empty() || closed; });
+				if (items.empty()) return item;
+				item.emplace(std::move(items.front()));
+				items.pop_front();
+			}
+			not_full.notify_one();
+			return item;
+		}
+		// Lets pop() return nullopt once the remaining items are taken.
+		void close() {
+			{
+				std::lock_guard lock{ mutex };
+				closed = true;
+			}
+			not_empty.notify_all();
+		}
+	private:
+		std::size_t capacity;
+		std::deque<T> items;
+		std::mutex mutex;
+		std::condition_variable not_full, not_empty;
+		bool closed = false;
+	};
+}
+
+#endif /* SDF_SCHEDULER_HPP */
@@ -2,25 +2,55 @@
 #define SDF_SCREEN_HPP
 #include <utility>
 #include <atomic>
+#include <cstdint>
+#include <memory>
 #include "math.hpp"
-
-struct SDL_Surface;
+#include "pixels.hpp"
+#include "region.hpp"
 
 namespace sdf {
-	extern vec3 camera_pos;
-	extern vec2 camera_rotation;
 	extern std::atomic_bool quit_requested;
+	// Everything the input thread hands to the renderer for one frame, published as a whole and never modified afterwards.
+	struct FrameState {
+		// increases with every published state
+		std::uint64_t version = 0;
+		// seconds since the screen was initialized
+		float time = 0.0f;
+		// increases whenever the scene changes
+		std::uint64_t scene_version = 0;
+		// camera pose, see PerspectiveCamera::pose()
+		vec3 position{};
+		vec2 rotation{};
+		// toggled with F2, frames are profiled while it is set
+		bool profiling = false;
+		// toggled with F3, shows the cost of every pixel instead of its color
+		bool heatmap = false;
+		// toggled with F4, moves an object through the scene
+		bool animate = false;
+	};
+	// Latest state published by the input thread, to be called by a single render thread once per frame.
+	[[nodiscard]]
+	FrameState acquire_frame_state() noexcept;
+	// The next published state carries a new scene version.
+	void scene_changed() noexcept;
 	struct PerspectiveCamera;
 	class Object;
+	class CompiledObject;
 	void init_screen(int width, int height, int scale);
 	bool screen_initialized() noexcept;
 	std::pair<int, int> surfaceSize() noexcept;
+	// Resolution of the frame being rendered, the window scales it up to the full surface.
+	std::pair<int, int> frameSize() noexcept;
+	void resize_frame(int width, int height) noexcept;
 	
-	SDL_Surface* createSubSurface(int ysize);
+	// Drawing and rendering write into the back buffer, which reaches the window once the frame is presented.
+	// The next back buffer starts as a copy of the presented frame, so a frame may redraw only what changed.
+	// Only the tiles drawn since that buffer was last the back buffer are copied.
 	void draw(int x, int y, Color color);
-	void blit(SDL_Surface* surface, int x, int y);
-	void renderSurface(SDL_Surface* surface, const PerspectiveCamera& camera, const std::shared_ptr<Object>& obj, int yoff = 0, int ysize = INT32_MAX, int xoff = 0, int xsize = INT32_MAX);
+	void present_frame();
+	void set_pixel_encoding(PixelEncoding encoding) noexcept;
 	void render(const PerspectiveCamera& camera, const std::shared_ptr<Object>& obj, int yoff = 0, int ysize = INT32_MAX, int xoff = 0, int xsize = INT32_MAX);
+	void render(const PerspectiveCamera& camera, const std::shared_ptr<CompiledObject>& obj, int yoff = 0, int ysize = INT32_MAX, int xoff = 0, int xsize = INT32_MAX, const RenderOptions& options = {});
 	void set_fps(float fps);
 }
 
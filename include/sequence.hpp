@@ -0,0 +1,54 @@
+#ifndef SDF_SEQUENCE_HPP
+#define SDF_SEQUENCE_HPP
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "math.hpp"
+#include "framebuffer.hpp"
+
+namespace sdf {
+	// Camera pose at a frame of an animation, see PerspectiveCamera::pose().
+	struct CameraKey {
+		float frame;
+		vec3 position;
+		vec2 rotation;
+	};
+	
+	// Camera paths hold one key per line, `FRAME X Y Z PITCH YAW`, with increasing frames,
+	// `#` starts a comment that runs to the end of the line.
+	// Malformed paths throw std::runtime_error naming the line.
+	[[nodiscard]]
+	std::vector<CameraKey> parse_camera_path(std::string_view text);
+	[[nodiscard]]
+	std::vector<CameraKey> load_camera_path(const std::string& path);
+	// Linear interpolation between the keys around `frame`, holding the first and last key outside of them.
+	[[nodiscard]]
+	CameraKey camera_at(const std::vector<CameraKey>& path, float frame) noexcept;
+	
+	enum class VideoFormat : std::uint8_t {
+		// YUV4MPEG2 with 4:2:0 chroma in limited range BT.601, read by ffmpeg, x264 and most encoders
+		Y4M,
+		// packed 8 bit RGB without any header
+		RGB,
+	};
+	
+	// Streams frames of a fixed size into a file or pipe, which it does not own.
+	class VideoWriter {
+	public:
+		VideoWriter(std::FILE* out, VideoFormat format, int width, int height, int fps) noexcept
+				: out(out), format(format), width(width), height(height), fps(fps) {}
+		
+		// Converts and writes one frame of the writer's size, returns false once the output failed.
+		bool write(const Framebuffer& frame);
+	private:
+		std::FILE* out;
+		VideoFormat format;
+		int width, height, fps;
+		bool started = false, failed = false;
+		std::vector<std::uint8_t> buffer;
+	};
+}
+
+#endif /* SDF_SEQUENCE_HPP */
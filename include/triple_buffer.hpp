@@ -0,0 +1,46 @@
+#ifndef SDF_TRIPLE_BUFFER_HPP
+#define SDF_TRIPLE_BUFFER_HPP
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sdf {
+	// Single producer, single consumer triple buffer. Neither side ever waits, the consumer always
+	// gets the most recently published buffer and unconsumed buffers are overwritten.
+	template<class T>
+	class TripleBuffer {
+	public:
+		TripleBuffer() = default;
+		explicit TripleBuffer(const T& value) : buffers{ value, value, value } {}
+		
+		// Buffer owned by the producer.
+		[[nodiscard]]
+		T& back() noexcept { return buffers[back_index]; }
+		// Buffer owned by the consumer.
+		[[nodiscard]]
+		const T& front() const noexcept { return buffers[front_index]; }
+		// Which of the three buffers back() is, for producers keeping state of their own per buffer.
+		[[nodiscard]]
+		std::size_t back_slot() const noexcept { return back_index; }
+		
+		// Hands the back buffer to the consumer and continues with the spare one.
+		void publish() noexcept {
+			back_index = middle.exchange(std::uint8_t(back_index | fresh), std::memory_order_acq_rel) & index_mask;
+		}
+		// Swaps in the latest published buffer, returns false if nothing new has been published.
+		bool acquire() noexcept {
+			if (!(middle.load(std::memory_order_relaxed) & fresh)) return false;
+			front_index = middle.exchange(front_index, std::memory_order_acq_rel) & index_mask;
+			return true;
+		}
+	private:
+		static constexpr std::uint8_t index_mask = 3, fresh = 4;
+		
+		std::array<T, 3> buffers{};
+		std::atomic_uint8_t middle{ 1 };
+		std::uint8_t back_index = 0, front_index = 2;
+	};
+}
+
+#endif /* SDF_TRIPLE_BUFFER_HPP */
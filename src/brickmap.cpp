@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "brickmap.hpp"
+#include "profiler.hpp"
+#include "raytracer.hpp"
+#include "scheduler.hpp"
+
+namespace sdf {
+	// the grid grows with the cube of 1 / voxel, the bricks along the surface about with its square
+	[[noreturn]]
+	static void refuse(float voxel, double bytes, std::size_t budget, double exponent) {
+		const double fitting = double(voxel) * std::pow(bytes / double(budget), exponent) * 1.1;
+		throw std::length_error("brick map needs " + std::to_string(std::size_t(bytes) >> 20) + " MiB, more than its budget of "
+			+ std::to_string(budget >> 20) + " MiB, try a voxel size of at least " + std::to_string(fitting));
+	}
+	
+	BrickMap BrickMap::build(const Object& scene, float voxel, TaskPool& pool, std::size_t budget) {
+		const Program program = Program::compile(scene);
+		BrickMap map{};
+		map.voxel = voxel;
+		
+		const Bounds b = scene.bounds();
+		if (!b.finite() || voxel <= 0.0f) return map;
+		
+		const float cell = voxel * brick_size;
+		const vec3 margin{ 2.0f * cell };
+		const vec3 extent = b.upper - b.lower + 2.0f * margin;
+		// counted in double, the cells of a tiny voxel overflow an int
+		double cells = 1.0;
+		for (int i = 0; i < 3; ++i)
+			cells *= std::max(1.0, std::ceil(double(extent[i]) / double(cell)));
+		const double grid = cells * double(sizeof(float) + sizeof(std::int32_t));
+		if (grid > double(budget)) refuse(voxel, grid, budget, 1.0 / 3.0);
+		for (int i = 0; i < 3; ++i)
+			map.cells[i] = std::max(1, int(std::ceil(extent[i] / cell)));
+		map.box.lower = b.lower - margin;
+		map.box.upper = map.box.lower + vec3{ float(map.cells[0]), float(map.cells[1]), float(map.cells[2]) } * cell;
+		
+		const int nx = map.cells[0], ny = map.cells[1], nz = map.cells[2];
+		const float radius = 0.5f * std::sqrt(3.0f) * cell;
+		map.coarse.resize(std::size_t(nx) * ny * nz);
+		map.bricks.assign(map.coarse.size(), -1);
+		pool.run(std::size_t(nz), [&](std::size_t z) {
+			for (int y = 0; y < ny; ++y) {
+				for (int x = 0; x < nx; ++x) {
+					const vec3 center = map.box.lower + (vec3{ float(x), float(y), float(z) } + 0.5f) * cell;
+					map.coarse[(z * ny + y) * nx + x] = program.distance(center);
+				}
+			}
+		});
+		
+		std::int32_t count = 0;
+		for (std::size_t i = 0; i < map.coarse.size(); ++i) {
+			if (std::abs(map.coarse[i]) <= radius + 2.0f * voxel)
+				map.bricks[i] = count++;
+			map.coarse[i] -= radius;
+		}
+		
+		constexpr int n = brick_size + 1;
+		const double bytes = grid + double(count) * n * n * n * sizeof(float);
+		if (bytes > double(budget)) refuse(voxel, bytes, budget, 0.5);
+		map.samples.resize(std::size_t(count) * n * n * n);
+		pool.run(map.coarse.size(), [&](std::size_t i) {
+			if (map.bricks[i] < 0) return;
+			const int x = int(i % nx), y = int(i / nx % ny), z = int(i / nx / ny);
+			const vec3 origin = map.box.lower + vec3{ float(x), float(y), float(z) } * cell;
+			float* out = &map.samples[std::size_t(map.bricks[i]) * n * n * n];
+			for (int k = 0; k < n; ++k)
+				for (int j = 0; j < n; ++j)
+					for (int l = 0; l < n; ++l)
+						*out++ = program.distance(origin + vec3{ float(l), float(j), float(k) } * voxel);
+		});
+		return map;
+	}
+	
+	std::size_t BrickMap::memory() const noexcept {
+		return coarse.size() * sizeof(float) + bricks.size() * sizeof(std::int32_t) + samples.size() * sizeof(float);
+	}
+	
+	float BrickMap::sample(vec3 p) const noexcept {
+		const float outside = box.distance(p);
+		if (outside > 0.0f) return outside;
+		
+		const float cell = voxel * brick_size;
+		const vec3 g = (p - box.lower) / cell;
+		const int x = std::clamp(int(g.x), 0, cells[0] - 1);
+		const int y = std::clamp(int(g.y), 0, cells[1] - 1);
+		const int z = std::clamp(int(g.z), 0, cells[2] - 1);
+		const std::size_t index = (std::size_t(z) * cells[1] + y) * cells[0] + x;
+		const std::int32_t brick = bricks[index];
+		if (brick < 0) return coarse[index];
+		
+		constexpr int n = brick_size + 1;
+		const vec3 v = glm::clamp((g - vec3{ float(x), float(y), float(z) }) * float(brick_size), 0.0f, float(brick_size) - 0.001f);
+		const int vx = int(v.x), vy = int(v.y), vz = int(v.z);
+		const float fx = v.x - float(vx), fy = v.y - float(vy), fz = v.z - float(vz);
+		const float* s = &samples[std::size_t(brick) * n * n * n + (std::size_t(vz) * n + vy) * n + vx];
+		const auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+		const float c00 = lerp(s[0], s[1], fx), c10 = lerp(s[n], s[n + 1], fx);
+		const float c01 = lerp(s[n * n], s[n * n + 1], fx), c11 = lerp(s[n * n + n], s[n * n + n + 1], fx);
+		// trilinear interpolation of a 1-Lipschitz field is off by at most half a voxel diagonal
+		return lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz) - 0.87f * voxel;
+	}
+	
+	MarchResult march(const BrickMap& cache, const Program& program, const Ray& ray, float bgDist, float start) noexcept {
+		const auto& settings = march_settings();
+		const float far = std::min(bgDist, exit_distance(program.bounds, ray));
+		// cached distances are lower bounds, any that could end the march is replaced by the exact one
+		const float exact = settings.epsilon + settings.pixel_cone * std::max(far, 0.0f);
+		return march([&](vec3 p) {
+			const float d = cache.sample(p);
+			return d < exact ? program.distance(p) : d;
+		}, ray, far, settings, start);
+	}
+	
+	Color trace(const BrickMap& cache, const std::shared_ptr<CompiledObject>& object, Ray ray, float bgDist, float start) {
+		if (cache.empty()) return trace(object, ray, bgDist);
+		const auto& program = object->program;
+		const auto result = march(cache, program, ray, bgDist, start);
+		ray.origin += ray.direction * result.t;
+		if (result.end == MarchEnd::Sky)
+			return project_background(ray);
+		++thread_evaluations;
+		const auto material = program.evaluate(ray.origin).second;
+		return program.materials[material]->shade(ray, object);
+	}
+	
+	void trace_region(const BrickMap& cache, const std::shared_ptr<CompiledObject>& object, const PerspectiveCamera& camera, int width, int height,
+			int xoff, int yoff, int xsize, int ysize, Color* out, float bgDist) {
+		const auto pixel = [&](float x, float y) { return camera.project(x / float(width), y / float(height)); };
+		for (int cy = 0; cy < ysize; cy += cone_tile) {
+			for (int cx = 0; cx < xsize; cx += cone_tile) {
+				const float x0 = float(xoff + cx), x1 = float(xoff + std::min(xsize, cx + cone_tile));
+				const float y0 = float(yoff + cy), y1 = float(yoff + std::min(ysize, cy + cone_tile));
+				const Ray axis = pixel(0.5f * (x0 + x1), 0.5f * (y0 + y1));
+				// the directions through the tile's outer corners bound all of its rays
+				float spread = 0.0f;
+				for (const auto [x, y] : { vec2{ x0, y0 }, vec2{ x1, y0 }, vec2{ x0, y1 }, vec2{ x1, y1 } })
+					spread = std::max(spread, glm::length(pixel(x, y).direction - axis.direction));
+				// the cached lower bound is all a cone needs, it stops a voxel early at worst
+				float t = 0.0f;
+				for (int i = 0; i < 64 && t < bgDist; ++i) {
+					const float step = (cache.sample(axis.origin + axis.direction * t) - spread * t) / (1.0f + spread);
+					if (step < 0.0001f) break;
+					t += step;
+				}
+				t = std::min(t, bgDist);
+				
+				for (int y = cy; y < std::min(ysize, cy + cone_tile); ++y)
+					for (int x = cx; x < std::min(xsize, cx + cone_tile); ++x)
+						out[std::size_t(y) * xsize + x] = trace(cache, object, pixel(float(xoff + x) + 0.5f, float(yoff + y) + 0.5f), bgDist, t);
+			}
+		}
+	}
+}
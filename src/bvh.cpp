@@ -0,0 +1,110 @@
+#include <algorithm>
+#include "program.hpp"
+
+namespace sdf {
+	namespace {
+		struct Member {
+			std::size_t index;
+			Bounds bounds;
+			vec3 offset{};
+		};
+		
+		void emit_cull(Program& program, const Bounds& b) {
+			program.code.push_back({ Opcode::Cull, 0, { b.lower.x, b.lower.y, b.lower.z, b.upper.x, b.upper.y, b.upper.z } });
+		}
+		
+		// Emits the members as a hierarchy of culled blocks, every member is unioned into the running minimum.
+		// Members of an instance table are the shared code translated by their offset.
+		void emit_node(Program& program, Member* first, Member* last, const Program::MemberEmitter* member, const std::vector<Instruction>* instance) {
+			Bounds box = first->bounds;
+			Bounds centers{ first->bounds.center(), first->bounds.center() };
+			for (auto* m = first + 1; m != last; ++m) {
+				box = merge(box, m->bounds);
+				centers = merge(centers, { m->bounds.center(), m->bounds.center() });
+			}
+			
+			const std::size_t cull = program.code.size();
+			emit_cull(program, box);
+			if (last - first == 1) {
+				if (instance) {
+					program.emit(Opcode::Translate, first->offset.x, first->offset.y, first->offset.z);
+					program.code.insert(program.code.end(), instance->begin(), instance->end());
+					program.emit(Opcode::Pop);
+				}
+				else (*member)(program, first->index);
+				program.emit(Opcode::Union);
+			}
+			else {
+				const vec3 extent = centers.upper - centers.lower;
+				const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+				auto* mid = first + (last - first) / 2;
+				std::nth_element(first, mid, last, [axis](const Member& a, const Member& b) {
+					return a.bounds.center()[axis] < b.bounds.center()[axis];
+				});
+				const std::size_t order = program.code.size();
+				program.emit(Opcode::Order, float(axis), mid->bounds.center()[axis]);
+				emit_node(program, first, mid, member, instance);
+				const std::size_t second = program.code.size();
+				emit_node(program, mid, last, member, instance);
+				program.code[order].material = std::uint32_t(second - order - 1);
+				program.code[order].length = std::uint32_t(program.code.size() - second);
+			}
+			program.code[cull].material = std::uint32_t(program.code.size() - cull - 1);
+		}
+	}
+	
+	void Program::emit_union(std::vector<const Object*> objects) {
+		std::vector<Bounds> bounds{};
+		bounds.reserve(objects.size());
+		for (const auto* obj : objects)
+			bounds.push_back(obj->bounds());
+		emit_union(bounds, [&objects](Program& program, std::size_t i) { objects[i]->compile(program); });
+	}
+	void Program::emit_union(const std::vector<Bounds>& bounds, const MemberEmitter& member) {
+		std::vector<Member> bounded{};
+		std::vector<std::size_t> unbounded{};
+		for (std::size_t i = 0; i < bounds.size(); ++i) {
+			if (bounds[i].finite()) bounded.push_back({ i, bounds[i] });
+			else unbounded.push_back(i);
+		}
+		
+		emit(Opcode::Infinity);
+		for (const auto i : unbounded) {
+			member(*this, i);
+			emit(Opcode::Union);
+		}
+		if (!bounded.empty())
+			emit_node(*this, bounded.data(), bounded.data() + bounded.size(), &member, nullptr);
+	}
+	
+	void Program::emit_instances(const Object& object, std::span<const vec3> offsets) {
+		emit_instances([&object](Program& program) { object.compile(program); }, object.bounds(), offsets);
+	}
+	void Program::emit_instances(const Emitter& object, const Bounds& b, std::span<const vec3> offsets) {
+		Program shared{};
+		object(shared);
+		for (auto& ins : shared.code) {
+			if (ins.op == Opcode::Sphere || ins.op == Opcode::Cube)
+				ins.material = material(shared.materials[ins.material]);
+		}
+		
+		emit(Opcode::Infinity);
+		if (!b.finite()) {
+			for (const auto& offset : offsets) {
+				emit(Opcode::Translate, offset.x, offset.y, offset.z);
+				code.insert(code.end(), shared.code.begin(), shared.code.end());
+				emit(Opcode::Pop);
+				emit(Opcode::Union);
+			}
+			return;
+		}
+		std::vector<Member> members{};
+		members.reserve(offsets.size());
+		for (const auto& offset : offsets)
+			members.push_back({ 0, { b.lower + offset, b.upper + offset }, offset });
+		// every leaf takes a cull, the shared code and three more instructions, inner nodes one cull each
+		code.reserve(code.size() + offsets.size() * (shared.code.size() + 5));
+		if (!members.empty())
+			emit_node(*this, members.data(), members.data() + members.size(), nullptr, &shared.code);
+	}
+}
@@ -0,0 +1,196 @@
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "distributed.hpp"
+
+namespace sdf {
+	// Both return false once the peer is gone, sends never raise SIGPIPE.
+	[[nodiscard]]
+	static bool send_all(int fd, const void* data, std::size_t size) noexcept {
+		auto bytes = static_cast<const std::uint8_t*>(data);
+		while (size > 0) {
+			const ssize_t sent = ::send(fd, bytes, size, MSG_NOSIGNAL);
+			if (sent < 0 && errno == EINTR) continue;
+			if (sent <= 0) return false;
+			bytes += sent, size -= std::size_t(sent);
+		}
+		return true;
+	}
+	[[nodiscard]]
+	static bool receive_all(int fd, void* data, std::size_t size) noexcept {
+		auto bytes = static_cast<std::uint8_t*>(data);
+		while (size > 0) {
+			const ssize_t received = ::recv(fd, bytes, size, 0);
+			if (received < 0 && errno == EINTR) continue;
+			if (received <= 0) return false;
+			bytes += received, size -= std::size_t(received);
+		}
+		return true;
+	}
+	
+	// Worker side: answers requests until the coordinator closes the socket, each reply is the tile followed by its rows.
+	[[noreturn]]
+	static void serve(int fd, int width, int height, PixelEncoding encoding, const TileWorkers::Renderer& render) {
+		try {
+			Framebuffer fb{ width, height };
+			fb.encoding = encoding;
+			Tile tile{};
+			while (receive_all(fd, &tile, sizeof(tile))) {
+				if (tile.x < 0 || tile.y < 0 || tile.width <= 0 || tile.height <= 0 || tile.x > width - tile.width || tile.y > height - tile.height)
+					break;
+				render(fb, tile);
+				bool ok = send_all(fd, &tile, sizeof(tile));
+				for (int y = tile.y; ok && y < tile.y + tile.height; ++y)
+					ok = send_all(fd, fb.pixels.data() + (std::size_t(y) * width + tile.x) * 4, std::size_t(tile.width) * 4);
+				if (!ok) break;
+			}
+		}
+		catch (const std::exception& e) {
+			spdlog::error("Tile worker {}: {}", ::getpid(), e.what());
+			std::_Exit(1);
+		}
+		// the coordinator's atexit handlers and static destructors are not ours to run
+		std::_Exit(0);
+	}
+	
+	TileWorkers::TileWorkers(std::size_t count, int width, int height, PixelEncoding encoding, const Renderer& render,
+			std::chrono::milliseconds timeout)
+			: width(width), height(height), timeout(timeout) {
+		int error = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			int fds[2];
+			if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+				error = errno;
+				break;
+			}
+			const pid_t pid = ::fork();
+			if (pid == 0) {
+				// earlier workers must see their socket close when the coordinator closes it
+				for (const auto& worker : workers) ::close(worker.fd);
+				::close(fds[0]);
+				serve(fds[1], width, height, encoding, render);
+			}
+			if (pid < 0) error = errno;
+			::close(fds[1]);
+			if (pid < 0) {
+				::close(fds[0]);
+				break;
+			}
+			workers.push_back({ pid, fds[0], {} });
+		}
+		if (workers.empty()) throw std::system_error(error, std::generic_category(), "cannot start tile workers");
+		if (workers.size() < count) spdlog::warn("Started {} of {} tile workers", workers.size(), count);
+	}
+	TileWorkers::~TileWorkers() {
+		for (const auto& worker : workers) ::close(worker.fd);
+		for (const auto& worker : workers) ::waitpid(worker.pid, nullptr, 0);
+	}
+	
+	void TileWorkers::drop(std::size_t index, std::deque<Tile>& queue) noexcept {
+		auto& worker = workers[index];
+		spdlog::warn("Tile worker {} failed, reassigning its {} tiles", worker.pid, worker.pending.size());
+		queue.insert(queue.begin(), worker.pending.begin(), worker.pending.end());
+		::close(worker.fd);
+		::kill(worker.pid, SIGKILL);
+		::waitpid(worker.pid, nullptr, 0);
+		workers.erase(workers.begin() + std::ptrdiff_t(index));
+	}
+	
+	void TileWorkers::expect(Worker& worker) const {
+		worker.received = 0;
+		if (worker.pending.empty()) return;
+		const auto& tile = worker.pending.front();
+		worker.reply.resize(sizeof(Tile) + std::size_t(tile.width) * std::size_t(tile.height) * 4);
+		worker.deadline = Clock::now() + timeout;
+	}
+	
+	bool TileWorkers::receive(Worker& worker, Framebuffer& fb, std::size_t& remaining) const {
+		// poll() only wakes us for data, a closed socket or an error, none of which an idle worker may send
+		if (worker.pending.empty()) return false;
+		while (!worker.pending.empty()) {
+			const ssize_t received = ::recv(worker.fd, worker.reply.data() + worker.received, worker.reply.size() - worker.received, MSG_DONTWAIT);
+			if (received < 0 && errno == EINTR) continue;
+			if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+			if (received <= 0) return false;
+			worker.received += std::size_t(received);
+			if (worker.received < worker.reply.size()) continue;
+			
+			// replies come back in request order, so anything else is a broken worker
+			Tile reply{};
+			std::memcpy(&reply, worker.reply.data(), sizeof(reply));
+			const auto& expected = worker.pending.front();
+			if (reply.x != expected.x || reply.y != expected.y || reply.width != expected.width || reply.height != expected.height
+				|| reply.frame != expected.frame)
+				return false;
+			const std::size_t row = std::size_t(reply.width) * 4;
+			for (int y = 0; y < reply.height; ++y)
+				std::memcpy(fb.pixels.data() + (std::size_t(reply.y + y) * width + reply.x) * 4, worker.reply.data() + sizeof(Tile) + std::size_t(y) * row, row);
+			worker.pending.pop_front();
+			expect(worker);
+			--remaining;
+		}
+		return true;
+	}
+	
+	bool TileWorkers::render(Framebuffer& fb, int tile, int frame) {
+		if (fb.width != width || fb.height != height) throw std::invalid_argument("frame size differs from the tile workers'");
+		std::deque<Tile> queue{};
+		for (int y = 0; y < height; y += tile)
+			for (int x = 0; x < width; x += tile)
+				queue.push_back({ x, y, std::min(tile, width - x), std::min(tile, height - y), frame });
+		std::size_t remaining = queue.size();
+		std::vector<pollfd> polls{};
+		while (remaining > 0) {
+			// a second request in flight hides the round trip behind the tile being traced
+			for (std::size_t i = workers.size(); i-- > 0;) {
+				auto& worker = workers[i];
+				bool ok = true;
+				while (ok && worker.pending.size() < 2 && !queue.empty()) {
+					ok = send_all(worker.fd, &queue.front(), sizeof(Tile));
+					if (ok) {
+						worker.pending.push_back(queue.front());
+						queue.pop_front();
+						if (worker.pending.size() == 1) expect(worker);
+					}
+				}
+				if (!ok) drop(i, queue);
+			}
+			if (workers.empty()) return false;
+			
+			// wait no longer than the first tile deadline, there always is one while tiles remain
+			polls.clear();
+			auto deadline = Clock::time_point::max();
+			for (const auto& worker : workers) {
+				polls.push_back({ worker.fd, POLLIN, 0 });
+				if (!worker.pending.empty()) deadline = std::min(deadline, worker.deadline);
+			}
+			const auto wait = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()).count();
+			if (::poll(polls.data(), polls.size(), int(std::clamp<decltype(wait)>(wait, 0, timeout.count()))) < 0) {
+				if (errno == EINTR) continue;
+				throw std::system_error(errno, std::generic_category(), "cannot poll tile workers");
+			}
+			const auto now = Clock::now();
+			for (std::size_t i = workers.size(); i-- > 0;) {
+				auto& worker = workers[i];
+				if (polls[i].revents != 0 && !receive(worker, fb, remaining)) {
+					drop(i, queue);
+					continue;
+				}
+				if (!worker.pending.empty() && worker.deadline <= now) {
+					spdlog::warn("Tile worker {} took longer than {} ms on a tile", worker.pid, timeout.count());
+					drop(i, queue);
+				}
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <fstream>
+#include <array>
+#include "framebuffer.hpp"
+#include "raytracer.hpp"
+#include "profiler.hpp"
+
+namespace sdf {
+	void Framebuffer::store(int x, int y, Color color) noexcept {
+		store(x, y, &color, 1);
+	}
+	void Framebuffer::store(int x, int y, const Color* colors, std::size_t count) noexcept {
+		encode_rgba(colors, &pixels[(std::size_t(y) * width + x) * 4], count, x, y, encoding);
+	}
+	
+	bool Framebuffer::write_ppm(const std::string& path) const {
+		std::ofstream out{ path, std::ios::binary };
+		if (!out) return false;
+		out << "P6\n" << width << ' ' << height << "\n255\n";
+		std::vector<char> row(std::size_t(width) * 3);
+		for (int y = 0; y < height; ++y) {
+			const auto* px = &pixels[std::size_t(y) * width * 4];
+			for (int x = 0; x < width; ++x)
+				for (int c = 0; c < 3; ++c)
+					row[x * 3 + c] = char(px[x * 4 + c]);
+			out.write(row.data(), std::streamsize(row.size()));
+		}
+		return bool(out);
+	}
+	
+	[[nodiscard]]
+	static std::uint32_t crc32(const std::uint8_t* data, std::size_t size, std::uint32_t crc = 0) noexcept {
+		static const auto table = [] {
+			std::array<std::uint32_t, 256> t{};
+			for (std::uint32_t i = 0; i < 256; ++i) {
+				std::uint32_t c = i;
+				for (int k = 0; k < 8; ++k)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[i] = c;
+			}
+			return t;
+		}();
+		crc = ~crc;
+		for (std::size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+	static void put_u32(std::vector<std::uint8_t>& out, std::uint32_t v) {
+		out.insert(out.end(), { std::uint8_t(v >> 24), std::uint8_t(v >> 16), std::uint8_t(v >> 8), std::uint8_t(v) });
+	}
+	static void put_chunk(std::ofstream& out, const char* type, const std::vector<std::uint8_t>& data) {
+		std::vector<std::uint8_t> chunk{};
+		put_u32(chunk, std::uint32_t(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		put_u32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+		out.write(reinterpret_cast<const char*>(chunk.data()), std::streamsize(chunk.size()));
+	}
+	
+	// Writes an RGBA PNG using uncompressed (stored) deflate blocks, so no zlib is required.
+	bool Framebuffer::write_png(const std::string& path) const {
+		std::ofstream out{ path, std::ios::binary };
+		if (!out) return false;
+		static constexpr std::uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+		
+		std::vector<std::uint8_t> header{};
+		put_u32(header, std::uint32_t(width));
+		put_u32(header, std::uint32_t(height));
+		header.insert(header.end(), { 8, 6, 0, 0, 0 });
+		put_chunk(out, "IHDR", header);
+		
+		std::vector<std::uint8_t> raw{};
+		const std::size_t stride = std::size_t(width) * 4;
+		raw.reserve((stride + 1) * height);
+		for (int y = 0; y < height; ++y) {
+			raw.push_back(0);
+			raw.insert(raw.end(), pixels.begin() + std::ptrdiff_t(y * stride), pixels.begin() + std::ptrdiff_t((y + 1) * stride));
+		}
+		
+		std::vector<std::uint8_t> zlib{ 0x78, 0x01 };
+		std::uint32_t a = 1, b = 0;
+		for (const auto byte : raw) {
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		for (std::size_t pos = 0; pos < raw.size(); pos += 65535) {
+			const auto len = std::uint16_t(std::min<std::size_t>(65535, raw.size() - pos));
+			zlib.push_back(pos + len >= raw.size() ? 1 : 0);
+			zlib.insert(zlib.end(), { std::uint8_t(len), std::uint8_t(len >> 8), std::uint8_t(~len), std::uint8_t(~len >> 8) });
+			zlib.insert(zlib.end(), raw.begin() + std::ptrdiff_t(pos), raw.begin() + std::ptrdiff_t(pos + len));
+		}
+		put_u32(zlib, (b << 16) | a);
+		put_chunk(out, "IDAT", zlib);
+		put_chunk(out, "IEND", {});
+		return bool(out);
+	}
+	
+	bool Framebuffer::write(const std::string& path) const {
+		const bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+		return png ? write_png(path) : write_ppm(path);
+	}
+	
+	void render(Framebuffer& fb, const PerspectiveCamera& camera, const std::shared_ptr<CompiledObject>& obj, int yoff, int ysize, int xoff, int xsize, const RenderOptions& options) {
+		const int gw = fb.width, gh = fb.height;
+		yoff = std::clamp(yoff, 0, gh);
+		ysize = std::clamp(ysize, 0, gh - yoff);
+		xoff = std::clamp(xoff, 0, gw);
+		xsize = std::clamp(xsize, 0, gw - xoff);
+		std::vector<Color> colors(std::size_t(xsize) * ysize);
+		render_region(obj, camera, gw, gh, xoff, yoff, xsize, ysize, colors.data(), options);
+		ProfileScope scope{ Stage::Blit };
+		for (int y = 0; y < ysize; ++y)
+			fb.store(xoff, yoff + y, &colors[std::size_t(y) * xsize], std::size_t(xsize));
+	}
+}
@@ -0,0 +1,45 @@
+#include <array>
+#include "governor.hpp"
+
+namespace sdf {
+	// ordered from best to cheapest, neighbouring levels differ by roughly a third of the cost
+	static constexpr std::array<RenderQuality, 8> levels{ {
+		{ 1.0f, false }, { 1.0f, true }, { 0.75f, false }, { 0.75f, true },
+		{ 0.5f, false }, { 0.5f, true }, { 0.35f, false }, { 0.25f, false },
+	} };
+	// frames to wait after a change before judging the new level
+	static constexpr int settle_frames = 4;
+	static constexpr int still_frames = 8;
+	
+	FrameGovernor::FrameGovernor(float target_fps) noexcept : budget(1.0f / target_fps) {}
+	
+	RenderQuality FrameGovernor::quality() const noexcept { return levels[level]; }
+	
+	RenderQuality FrameGovernor::update(float seconds, bool moving) noexcept {
+		if (!moving) {
+			if (still < still_frames && ++still == still_frames)
+				resume = level, level = 0;
+			if (still == still_frames) return quality();
+		}
+		else {
+			// pick up the level that held the frame rate before the camera stopped
+			const bool resumed = still == still_frames;
+			still = 0;
+			if (resumed) {
+				level = resume, settle = settle_frames, average = 0.0f;
+				return quality();
+			}
+		}
+		
+		average = average == 0.0f ? seconds : 0.8f * average + 0.2f * seconds;
+		if (settle > 0) {
+			--settle;
+			return quality();
+		}
+		if (average > 1.1f * budget && level + 1 < levels.size())
+			++level, settle = settle_frames, average = 0.0f;
+		else if (average < 0.6f * budget && level > 0)
+			--level, settle = settle_frames, average = 0.0f;
+		return quality();
+	}
+}
@@ -0,0 +1,372 @@
+#include <cmath>
+#include <stdexcept>
+#include "graph.hpp"
+
+namespace sdf {
+	namespace {
+		[[nodiscard]]
+		int arity(NodeKind kind) noexcept {
+			switch (kind) {
+			case NodeKind::Sphere:
+			case NodeKind::Cube: return 0;
+			case NodeKind::Union:
+			case NodeKind::Intersection:
+			case NodeKind::Subtraction:
+			case NodeKind::SmoothUnion:
+			case NodeKind::SmoothIntersection:
+			case NodeKind::SmoothSubtraction: return 2;
+			default: return 1;
+			}
+		}
+		[[nodiscard]]
+		bool transform(NodeKind kind) noexcept {
+			return kind == NodeKind::Translation || kind == NodeKind::RotationX || kind == NodeKind::RotationY || kind == NodeKind::Affine;
+		}
+		
+		// Rows and offset of a transform like Affine stores them.
+		struct Map {
+			vec3 x{ 1.0f, 0.0f, 0.0f }, y{ 0.0f, 1.0f, 0.0f }, z{ 0.0f, 0.0f, 1.0f }, offset{};
+		};
+		[[nodiscard]]
+		Map own(const Node& n) noexcept {
+			const auto& p = n.params;
+			const float s = std::sin(p[0]), c = std::cos(p[0]);
+			switch (n.kind) {
+			case NodeKind::Translation: return { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, -vec3{ p[0], p[1], p[2] } };
+			case NodeKind::RotationX: return { { 1.0f, 0.0f, 0.0f }, { 0.0f, c, -s }, { 0.0f, s, c }, {} };
+			case NodeKind::RotationY: return { { c, 0.0f, -s }, { 0.0f, 1.0f, 0.0f }, { s, 0.0f, c }, {} };
+			default: return { { p[0], p[1], p[2] }, { p[3], p[4], p[5] }, { p[6], p[7], p[8] }, { p[9], p[10], p[11] } };
+			}
+		}
+		// applies the inner map n after m, in the order and rounding of Affine::fuse()
+		void then(Map& m, const Map& n) noexcept {
+			const vec3 ax = m.x, ay = m.y, az = m.z;
+			m.x = n.x.x * ax + n.x.y * ay + n.x.z * az;
+			m.y = n.y.x * ax + n.y.y * ay + n.y.z * az;
+			m.z = n.z.x * ax + n.z.y * ay + n.z.z * az;
+			m.offset = vec3{ glm::dot(n.x, m.offset), glm::dot(n.y, m.offset), glm::dot(n.z, m.offset) } + n.offset;
+		}
+		// its object is never evaluated
+		[[nodiscard]]
+		Affine affine_map(const Map& m) { return Affine{ nullptr, m.x, m.y, m.z, m.offset }; }
+	}
+	
+	// What freeze() makes of the nodes reached from a top node: transforms become Affine objects if they fuse
+	// a chain or come from an Affine node, single translations and rotations stay as they are.
+	struct SceneGraph::Layout {
+		std::vector<bool> reached;
+		std::vector<std::optional<Map>> maps;
+		// node below the fused chain
+		std::vector<NodeId> bases;
+		std::vector<Bounds> bounds;
+	};
+	
+	MaterialId SceneGraph::material(const std::shared_ptr<Shader>& shader) {
+		materials.push_back(shader);
+		return MaterialId(materials.size() - 1);
+	}
+	
+	void SceneGraph::check(NodeId id, const Node& node) const {
+		const auto precedes = [id](NodeId child) { return child != no_node && child < id; };
+		const int children = arity(node.kind);
+		if ((children > 0 && !precedes(node.first)) || (children > 1 && !precedes(node.second)))
+			throw std::out_of_range("scene graph child does not precede its parent");
+		if ((node.kind == NodeKind::Sphere || node.kind == NodeKind::Cube) && node.index >= materials.size())
+			throw std::out_of_range("unknown scene graph material");
+		if (node.kind == NodeKind::Instances && (node.index > offsets.size() || node.count > offsets.size() - node.index))
+			throw std::out_of_range("scene graph instances past the offset table");
+	}
+	NodeId SceneGraph::add(const Node& node) {
+		if (nodes.size() == no_node) throw std::out_of_range("scene graph full");
+		check(NodeId(nodes.size()), node);
+		nodes.push_back(node);
+		return NodeId(nodes.size() - 1);
+	}
+	void SceneGraph::update(NodeId id, const Node& node) {
+		if (id >= nodes.size()) throw std::out_of_range("unknown scene graph node");
+		check(id, node);
+		const auto before = layout(id).bounds[id];
+		nodes[id] = node;
+		const auto after = layout(id).bounds[id];
+		++edits;
+		const Bounds changed = merge(before, after);
+		for (auto& [other, b] : touched) {
+			if (other != id) continue;
+			b = merge(b, changed);
+			return;
+		}
+		touched.emplace_back(id, changed);
+	}
+	NodeId SceneGraph::sphere(float radius, MaterialId material) {
+		return add({ NodeKind::Sphere, no_node, no_node, material, 0, { radius } });
+	}
+	NodeId SceneGraph::cube(float size, MaterialId material) {
+		return add({ NodeKind::Cube, no_node, no_node, material, 0, { size } });
+	}
+	NodeId SceneGraph::translation(NodeId object, vec3 offset) {
+		return add({ NodeKind::Translation, object, no_node, 0, 0, { offset.x, offset.y, offset.z } });
+	}
+	NodeId SceneGraph::rotation_x(NodeId object, float angle) {
+		return add({ NodeKind::RotationX, object, no_node, 0, 0, { angle } });
+	}
+	NodeId SceneGraph::rotation_y(NodeId object, float angle) {
+		return add({ NodeKind::RotationY, object, no_node, 0, 0, { angle } });
+	}
+	NodeId SceneGraph::unite(NodeId a, NodeId b) { return add({ NodeKind::Union, a, b }); }
+	NodeId SceneGraph::intersection(NodeId a, NodeId b) { return add({ NodeKind::Intersection, a, b }); }
+	NodeId SceneGraph::subtraction(NodeId a, NodeId b) { return add({ NodeKind::Subtraction, a, b }); }
+	NodeId SceneGraph::affine(NodeId object, vec3 x, vec3 y, vec3 z, vec3 offset) {
+		return add({ NodeKind::Affine, object, no_node, 0, 0, { x.x, x.y, x.z, y.x, y.y, y.z, z.x, z.y, z.z, offset.x, offset.y, offset.z } });
+	}
+	NodeId SceneGraph::repetition(NodeId object, vec3 period, vec3 limit) {
+		return add({ NodeKind::Repetition, object, no_node, 0, 0, { period.x, period.y, period.z, limit.x, limit.y, limit.z } });
+	}
+	NodeId SceneGraph::mirror(NodeId object, bool x, bool y, bool z) {
+		return add({ NodeKind::Mirror, object, no_node, 0, 0, { float(x), float(y), float(z) } });
+	}
+	NodeId SceneGraph::smooth_union(NodeId a, NodeId b, float k) { return add({ NodeKind::SmoothUnion, a, b, 0, 0, { k } }); }
+	NodeId SceneGraph::smooth_intersection(NodeId a, NodeId b, float k) { return add({ NodeKind::SmoothIntersection, a, b, 0, 0, { k } }); }
+	NodeId SceneGraph::smooth_subtraction(NodeId a, NodeId b, float k) { return add({ NodeKind::SmoothSubtraction, a, b, 0, 0, { k } }); }
+	NodeId SceneGraph::instances(NodeId object, const std::vector<vec3>& table) {
+		const auto first = std::uint32_t(offsets.size());
+		offsets.insert(offsets.end(), table.begin(), table.end());
+		return add({ NodeKind::Instances, object, no_node, first, std::uint32_t(table.size()) });
+	}
+	
+	SceneGraph::Layout SceneGraph::layout(NodeId top) const {
+		if (top == no_node) throw std::runtime_error("scene graph without root");
+		if (top >= nodes.size()) throw std::out_of_range("scene graph root past its nodes");
+		Layout l{ std::vector<bool>(std::size_t(top) + 1), std::vector<std::optional<Map>>(std::size_t(top) + 1),
+			std::vector<NodeId>(std::size_t(top) + 1, no_node), std::vector<Bounds>(std::size_t(top) + 1) };
+		// parents follow their children, so one pass down from the top finds every node it reaches
+		l.reached[top] = true;
+		for (NodeId i = top + 1; i-- > 0;) {
+			if (!l.reached[i]) continue;
+			check(i, nodes[i]);
+			if (nodes[i].first != no_node) l.reached[nodes[i].first] = true;
+			if (nodes[i].second != no_node) l.reached[nodes[i].second] = true;
+		}
+		
+		// and one pass up lays out each of them after its children
+		for (NodeId i = 0; i <= top; ++i) {
+			if (!l.reached[i]) continue;
+			const auto& n = nodes[i];
+			const auto& p = n.params;
+			const Bounds a = n.first != no_node ? l.bounds[n.first] : Bounds{};
+			const Bounds b = n.second != no_node ? l.bounds[n.second] : Bounds{};
+			auto& r = l.bounds[i];
+			switch (n.kind) {
+			case NodeKind::Sphere: r = { vec3{ -p[0] }, vec3{ p[0] } }; break;
+			case NodeKind::Cube: r = { vec3{ -p[0] / 2 }, vec3{ p[0] / 2 } }; break;
+			case NodeKind::Translation:
+			case NodeKind::RotationX:
+			case NodeKind::RotationY:
+			case NodeKind::Affine: {
+				// the child is already a single transform or a fused one, so the walk of Affine::fuse() ends below it
+				const NodeId c = n.first;
+				if (transform(nodes[c].kind)) {
+					Map m{};
+					then(m, own(n));
+					then(m, l.maps[c] ? *l.maps[c] : own(nodes[c]));
+					l.maps[i] = m;
+					l.bases[i] = l.maps[c] ? l.bases[c] : nodes[c].first;
+				}
+				else {
+					if (n.kind == NodeKind::Affine) l.maps[i] = own(n);
+					l.bases[i] = c;
+				}
+				if (l.maps[i]) r = affine_bounds(affine_map(*l.maps[i]), l.bounds[l.bases[i]]);
+				else if (n.kind == NodeKind::Translation) r = { a.lower + vec3{ p[0], p[1], p[2] }, a.upper + vec3{ p[0], p[1], p[2] } };
+				else if (n.kind == NodeKind::RotationX) r = rotate_x_bounds(a, std::sin(p[0]), std::cos(p[0]));
+				else r = rotate_y_bounds(a, std::sin(p[0]), std::cos(p[0]));
+				break;
+			}
+			case NodeKind::Union: r = merge(a, b); break;
+			case NodeKind::Intersection:
+			case NodeKind::SmoothIntersection: r = intersect(a, b); break;
+			case NodeKind::Subtraction:
+			case NodeKind::SmoothSubtraction: r = a; break;
+			case NodeKind::Repetition: r = repeat_bounds(a, { p[0], p[1], p[2] }, { p[3], p[4], p[5] }); break;
+			case NodeKind::Mirror: {
+				const bool axes[3]{ p[0] != 0.0f, p[1] != 0.0f, p[2] != 0.0f };
+				r = mirror_bounds(a, axes);
+				break;
+			}
+			case NodeKind::SmoothUnion: {
+				const auto m = merge(a, b);
+				r = { m.lower - p[0] * 0.25f, m.upper + p[0] * 0.25f };
+				break;
+			}
+			case NodeKind::Instances: r = instance_bounds(a, { offsets.data() + n.index, n.count }); break;
+			}
+		}
+		return l;
+	}
+	
+	std::optional<Bounds> SceneGraph::changes() const {
+		if (touched.empty()) return std::nullopt;
+		const auto reached = layout(root).reached;
+		// changes below a node map into its space like its bounds do, blends reshape up to k around them
+		std::vector<std::optional<Bounds>> changed(reached.size());
+		for (const auto& [id, b] : touched) {
+			if (id < reached.size() && reached[id]) changed[id] = b;
+		}
+		const auto either = [](const std::optional<Bounds>& a, const std::optional<Bounds>& b) -> std::optional<Bounds> {
+			if (!a) return b;
+			if (!b) return a;
+			return merge(*a, *b);
+		};
+		for (NodeId i = 0; i < reached.size(); ++i) {
+			if (!reached[i]) continue;
+			const auto& n = nodes[i];
+			const auto& p = n.params;
+			std::optional<Bounds> below{};
+			if (n.first != no_node) below = either(changed[n.first], n.second != no_node ? changed[n.second] : std::nullopt);
+			if (!below) continue;
+			Bounds b = *below;
+			switch (n.kind) {
+			case NodeKind::Translation: b = { b.lower + vec3{ p[0], p[1], p[2] }, b.upper + vec3{ p[0], p[1], p[2] } }; break;
+			case NodeKind::RotationX: b = rotate_x_bounds(b, std::sin(p[0]), std::cos(p[0])); break;
+			case NodeKind::RotationY: b = rotate_y_bounds(b, std::sin(p[0]), std::cos(p[0])); break;
+			case NodeKind::Affine: b = affine_bounds(affine_map(own(n)), b); break;
+			case NodeKind::Repetition: b = repeat_bounds(b, { p[0], p[1], p[2] }, { p[3], p[4], p[5] }); break;
+			case NodeKind::Mirror: {
+				const bool axes[3]{ p[0] != 0.0f, p[1] != 0.0f, p[2] != 0.0f };
+				b = mirror_bounds(b, axes);
+				break;
+			}
+			case NodeKind::SmoothUnion:
+			case NodeKind::SmoothIntersection:
+			case NodeKind::SmoothSubtraction: b = { b.lower - p[0], b.upper + p[0] }; break;
+			case NodeKind::Instances: b = instance_bounds(b, { offsets.data() + n.index, n.count }); break;
+			default: break;
+			}
+			changed[i] = either(changed[i], b);
+		}
+		return changed[root];
+	}
+	
+	void SceneGraph::emit(Program& program, NodeId id, const Layout& layout) const {
+		const auto& n = nodes[id];
+		const auto& p = n.params;
+		switch (n.kind) {
+		case NodeKind::Sphere: program.emit(Opcode::Sphere, p[0], 0.0f, 0.0f, program.material(materials[n.index])); return;
+		case NodeKind::Cube: program.emit(Opcode::Cube, p[0], 0.0f, 0.0f, program.material(materials[n.index])); return;
+		case NodeKind::Translation:
+		case NodeKind::RotationX:
+		case NodeKind::RotationY:
+		case NodeKind::Affine: {
+			if (const auto& m = layout.maps[id]) {
+				program.code.push_back({ Opcode::Affine, 0, { m->x.x, m->x.y, m->x.z, m->y.x, m->y.y, m->y.z } });
+				program.code.push_back({ Opcode::Operand, 0, { m->z.x, m->z.y, m->z.z, m->offset.x, m->offset.y, m->offset.z } });
+				emit(program, layout.bases[id], layout);
+				const float scale = affine_map(*m).scale;
+				if (scale != 1.0f) program.emit(Opcode::Scale, scale);
+			}
+			else {
+				if (n.kind == NodeKind::Translation) program.emit(Opcode::Translate, p[0], p[1], p[2]);
+				else program.emit(n.kind == NodeKind::RotationX ? Opcode::RotateX : Opcode::RotateY, std::sin(p[0]), std::cos(p[0]));
+				emit(program, n.first, layout);
+			}
+			program.emit(Opcode::Pop);
+			return;
+		}
+		case NodeKind::Union: {
+			std::vector<NodeId> members{};
+			const auto collect = [&](const auto& self, NodeId m) -> void {
+				if (nodes[m].kind != NodeKind::Union) {
+					members.push_back(m);
+					return;
+				}
+				self(self, nodes[m].first);
+				self(self, nodes[m].second);
+			};
+			collect(collect, id);
+			if (members.size() >= min_bvh_members) {
+				std::vector<Bounds> bounds{};
+				bounds.reserve(members.size());
+				for (const auto m : members)
+					bounds.push_back(layout.bounds[m]);
+				program.emit_union(bounds, [&](Program& target, std::size_t i) { emit(target, members[i], layout); });
+				return;
+			}
+			emit(program, n.first, layout);
+			emit(program, n.second, layout);
+			program.emit(Opcode::Union);
+			return;
+		}
+		case NodeKind::Intersection:
+		case NodeKind::Subtraction:
+		case NodeKind::SmoothUnion:
+		case NodeKind::SmoothIntersection:
+		case NodeKind::SmoothSubtraction: {
+			emit(program, n.first, layout);
+			emit(program, n.second, layout);
+			const Opcode op = n.kind == NodeKind::Intersection ? Opcode::Intersection : n.kind == NodeKind::Subtraction ? Opcode::Subtraction
+				: n.kind == NodeKind::SmoothUnion ? Opcode::SmoothUnion : n.kind == NodeKind::SmoothIntersection ? Opcode::SmoothIntersection
+				: Opcode::SmoothSubtraction;
+			if (op == Opcode::Intersection || op == Opcode::Subtraction) program.emit(op);
+			else program.emit(op, p[0]);
+			return;
+		}
+		case NodeKind::Repetition:
+			program.code.push_back({ Opcode::Repeat, 0, { p[0], p[1], p[2], p[3], p[4], p[5] } });
+			emit(program, n.first, layout);
+			program.emit(Opcode::Pop);
+			return;
+		case NodeKind::Mirror:
+			program.emit(Opcode::Mirror, float(p[0] != 0.0f), float(p[1] != 0.0f), float(p[2] != 0.0f));
+			emit(program, n.first, layout);
+			program.emit(Opcode::Pop);
+			return;
+		case NodeKind::Instances:
+			program.emit_instances([this, &n, &layout](Program& target) { emit(target, n.first, layout); }, layout.bounds[n.first],
+				{ offsets.data() + n.index, n.count });
+			return;
+		}
+	}
+	Program SceneGraph::compile() const {
+		const auto l = layout(root);
+		Program program{};
+		emit(program, root, l);
+		program.bounds = l.bounds[root];
+		program.validate();
+		return program;
+	}
+	
+	std::shared_ptr<Object> SceneGraph::freeze() const {
+		const auto reached = layout(root).reached;
+		// one pass up builds each reached node after its children
+		std::vector<std::shared_ptr<Object>> objects(std::size_t(root) + 1);
+		for (NodeId i = 0; i <= root; ++i) {
+			if (!reached[i]) continue;
+			const auto& n = nodes[i];
+			const auto& p = n.params;
+			const auto& a = n.first != no_node ? objects[n.first] : nullptr;
+			const auto& b = n.second != no_node ? objects[n.second] : nullptr;
+			auto& object = objects[i];
+			switch (n.kind) {
+			case NodeKind::Sphere: object = std::make_shared<Sphere>(p[0], materials[n.index]); break;
+			case NodeKind::Cube: object = std::make_shared<Cube>(p[0], materials[n.index]); break;
+			case NodeKind::Translation: object = Affine::fuse(std::make_shared<Translation>(a, vec3{ p[0], p[1], p[2] })); break;
+			case NodeKind::RotationX: object = Affine::fuse(std::make_shared<RotationX>(a, p[0])); break;
+			case NodeKind::RotationY: object = Affine::fuse(std::make_shared<RotationY>(a, p[0])); break;
+			case NodeKind::Union: object = std::make_shared<Union>(a, b); break;
+			case NodeKind::Intersection: object = std::make_shared<Intersection>(a, b); break;
+			case NodeKind::Subtraction: object = std::make_shared<Subtraction>(a, b); break;
+			case NodeKind::Affine:
+				object = Affine::fuse(std::make_shared<Affine>(a, vec3{ p[0], p[1], p[2] }, vec3{ p[3], p[4], p[5] }, vec3{ p[6], p[7], p[8] }, vec3{ p[9], p[10], p[11] }));
+				break;
+			case NodeKind::Repetition: object = std::make_shared<Repetition>(a, vec3{ p[0], p[1], p[2] }, vec3{ p[3], p[4], p[5] }); break;
+			case NodeKind::Mirror: object = std::make_shared<Mirror>(a, p[0] != 0.0f, p[1] != 0.0f, p[2] != 0.0f); break;
+			case NodeKind::SmoothUnion: object = std::make_shared<SmoothUnion>(a, b, p[0]); break;
+			case NodeKind::SmoothIntersection: object = std::make_shared<SmoothIntersection>(a, b, p[0]); break;
+			case NodeKind::SmoothSubtraction: object = std::make_shared<SmoothSubtraction>(a, b, p[0]); break;
+			case NodeKind::Instances:
+				object = std::make_shared<Instances>(a, std::vector<vec3>(offsets.begin() + n.index, offsets.begin() + n.index + n.count));
+				break;
+			}
+		}
+		return objects[root];
+	}
+}
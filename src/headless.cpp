@@ -0,0 +1,380 @@
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <array>
+#include <atomic>
+#include <thread>
+#include "raytracer.hpp"
+#include "framebuffer.hpp"
+#include "brickmap.hpp"
+#include "reprojection.hpp"
+#include "scheduler.hpp"
+#include "scene.hpp"
+#include "lighting.hpp"
+#include "profiler.hpp"
+#include "sequence.hpp"
+#include "distributed.hpp"
+
+using namespace sdf;
+
+static auto now() { return std::chrono::high_resolution_clock::now(); }
+
+static void usage(const char* name) {
+	std::fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -o FILE     output image, .png or .ppm (default: out.ppm), animations write .y4m or .rgb video, - for Y4M on stdout\n"
+		"  -i FILE     scene description to render (default: the built-in demo scene)\n"
+		"  -s WxH      resolution (default: 640x360)\n"
+		"  -p X,Y,Z    camera position (default: 0,0,0)\n"
+		"  -r X,Y      camera rotation in radians (default: 0,0)\n"
+		"  -t N        number of render threads (default: all cores)\n"
+		"  -n N        render the frame N times and report the average\n"
+		"  -c SIZE     march through a brick map distance cache of at most 64 MiB with the given voxel size, for scenes slow to evaluate\n"
+		"  -T          warm start repeated frames from the depths of the previous one\n"
+		"  -x OMEGA    over-relaxation factor of the sphere tracer (default: 1.4)\n"
+		"  -m N        maximum number of march steps per ray (default: 256)\n"
+		"  -e SCALE    grow the hit threshold by SCALE pixel footprints per unit of length (default: 1)\n"
+		"  -S          report march statistics of the frame\n"
+		"  -g          encode the image with the sRGB transfer function\n"
+		"  -d          dither the image with a 4x4 ordered pattern\n"
+		"  -a N        trace N extra jittered rays for pixels on edges\n"
+		"  -A          accumulate jittered samples over the repeated frames\n"
+		"  -l          plain lighting without shadows or ambient occlusion\n"
+		"  -k          trace every shadow ray instead of reusing those of neighbouring pixels\n"
+		"  -F          render the demo scene compiled into the binary as a fixed scene, pixel by pixel\n"
+		"  -P FILE     profile the frames and write a Chrome trace of them\n"
+		"  -H N        show the SDF evaluations per pixel as a heatmap, N of them are red\n"
+		"  -N N        render an animation of N frames along the camera path\n"
+		"  -K FILE     camera path of the animation, lines of FRAME X Y Z PITCH YAW (default: -p and -r throughout)\n"
+		"  -f FPS      frame rate stored in Y4M output (default: 30)\n"
+		"  -W N        trace in N worker processes on this host, each with -t threads (default: all cores shared among them)\n",
+		name);
+}
+
+// Renders the frames of an animation into a video, the pool traces a frame while a writer thread converts and writes the previous ones.
+static bool render_sequence(const std::shared_ptr<CompiledObject>& object, const std::vector<CameraKey>& path, int frames, int width, int height,
+		const std::string& output, int fps, PixelEncoding encoding, TaskPool& pool, TileWorkers* workers, RenderOptions options) {
+	// the camera moves between frames, so there is nothing to accumulate
+	options.accumulation = nullptr;
+	VideoFormat format = VideoFormat::Y4M;
+	std::FILE* out = stdout;
+	if (output != "-") {
+		if (output.ends_with(".rgb")) format = VideoFormat::RGB;
+		else if (!output.ends_with(".y4m")) {
+			spdlog::error("Animations are written as .y4m or .rgb, not {}", output);
+			return false;
+		}
+		out = std::fopen(output.c_str(), "wb");
+		if (!out) {
+			spdlog::critical("Failed to open {}", output);
+			return false;
+		}
+	}
+	// frames in flight, enough to keep both sides busy without holding the whole animation
+	constexpr std::size_t depth = 2;
+	BoundedQueue<Framebuffer> filled{ depth }, spare{ depth + 1 };
+	for (std::size_t i = 0; i < depth + 1; ++i) {
+		Framebuffer fb{ width, height };
+		fb.encoding = encoding;
+		spare.push(std::move(fb));
+	}
+	std::atomic_bool failed = false;
+	std::thread writer{ [&] {
+		VideoWriter video{ out, format, width, height, fps };
+		while (auto fb = filled.pop()) {
+			if (!failed && !video.write(*fb)) failed = true;
+			spare.push(std::move(*fb));
+		}
+	} };
+	
+	constexpr int tile = 16, workerTile = 64;
+	const int tilesX = (width + tile - 1) / tile, tilesY = (height + tile - 1) / tile;
+	PerspectiveCamera camera{};
+	double stalled = 0.0;
+	bool traced = true;
+	int n = 0;
+	const auto start = now();
+	for (; n < frames && !failed; ++n) {
+		const auto waitStart = now();
+		auto fb = std::move(*spare.pop());
+		stalled += std::chrono::duration<double>(now() - waitStart).count();
+		profile_frame(std::uint64_t(n));
+		if (workers) {
+			ProfileScope frameScope{ Stage::Frame };
+			// the workers pose their own cameras from the frame number
+			if (!workers->render(fb, workerTile, n)) {
+				spdlog::critical("All tile workers failed");
+				traced = false;
+				spare.push(std::move(fb));
+				break;
+			}
+		}
+		else {
+			ProfileScope frameScope{ Stage::Frame };
+			const auto key = camera_at(path, float(n));
+			camera.pose(key.position, key.rotation);
+			auto lighting = lighting_settings();
+			lighting.eye = camera.origin();
+			set_lighting_settings(lighting);
+			if (options.temporal)
+				options.temporal->begin_frame(camera, pool);
+			pool.run(std::size_t(tilesX * tilesY), [&](std::size_t i) {
+				const int tx = int(i) % tilesX, ty = int(i) / tilesX;
+				render(fb, camera, object, ty * tile, tile, tx * tile, tile, options);
+				flush_evaluations();
+			});
+		}
+		filled.push(std::move(fb));
+	}
+	filled.close();
+	writer.join();
+	const auto seconds = std::chrono::duration<double>(now() - start).count();
+	if (out != stdout) failed = std::fclose(out) != 0 || failed;
+	spdlog::info("Rendered {} frames of {}x{} on {} in {:.3f} s ({:.2f} frames/s, {:.3f} s waiting for the writer)",
+		n, width, height, workers ? fmt::format("{} workers", workers->size()) : fmt::format("{} threads", pool.size()), seconds, double(n) / seconds, stalled);
+	if (failed) spdlog::critical("Failed to write {}", output == "-" ? "stdout" : output);
+	return !failed && traced;
+}
+
+int main(int argc, char** argv) {
+	std::string output = "out.ppm", input{}, profile{}, cameraPath{};
+	int frames = 0, fps = 30, workerCount = 0;
+	float heatmap = 0.0f;
+	int width = 640, height = 360, repeat = 1;
+	float voxel = 0.0f;
+	bool reproject = false, statistics = false, accumulate = false, fixed = false;
+	int edge_samples = 0;
+	LightingSettings lighting = lighting_settings();
+	PixelEncoding encoding{};
+	float footprints = 1.0f;
+	MarchSettings settings = march_settings();
+	vec3 position{};
+	vec2 rotation{};
+	std::size_t threads = 0;
+	
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		if (!std::strcmp(arg, "-T")) { reproject = true; continue; }
+		if (!std::strcmp(arg, "-S")) { statistics = true; continue; }
+		if (!std::strcmp(arg, "-g")) { encoding.srgb = true; continue; }
+		if (!std::strcmp(arg, "-d")) { encoding.dither = true; continue; }
+		if (!std::strcmp(arg, "-A")) { accumulate = true; continue; }
+		if (!std::strcmp(arg, "-l")) { lighting.shadows = lighting.occlusion = false; lighting.ambient = 0.0f; continue; }
+		if (!std::strcmp(arg, "-k")) { lighting.cache_cell = 0.0f; continue; }
+		if (!std::strcmp(arg, "-F")) { fixed = true; continue; }
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool ok = value != nullptr;
+		if (ok && !std::strcmp(arg, "-o")) output = value;
+		else if (ok && !std::strcmp(arg, "-i")) input = value;
+		else if (ok && !std::strcmp(arg, "-P")) profile = value;
+		else if (ok && !std::strcmp(arg, "-K")) cameraPath = value;
+		else if (ok && !std::strcmp(arg, "-N")) ok = std::sscanf(value, "%d", &frames) == 1 && frames > 0;
+		else if (ok && !std::strcmp(arg, "-W")) ok = std::sscanf(value, "%d", &workerCount) == 1 && workerCount > 0;
+		else if (ok && !std::strcmp(arg, "-f")) ok = std::sscanf(value, "%d", &fps) == 1 && fps > 0;
+		else if (ok && !std::strcmp(arg, "-H")) ok = std::sscanf(value, "%f", &heatmap) == 1 && heatmap > 0.0f;
+		else if (ok && !std::strcmp(arg, "-s")) ok = std::sscanf(value, "%dx%d", &width, &height) == 2 && width > 0 && height > 0;
+		else if (ok && !std::strcmp(arg, "-p")) ok = std::sscanf(value, "%f,%f,%f", &position.x, &position.y, &position.z) == 3;
+		else if (ok && !std::strcmp(arg, "-r")) ok = std::sscanf(value, "%f,%f", &rotation.x, &rotation.y) == 2;
+		else if (ok && !std::strcmp(arg, "-t")) ok = std::sscanf(value, "%zu", &threads) == 1 && threads > 0;
+		else if (ok && !std::strcmp(arg, "-n")) ok = std::sscanf(value, "%d", &repeat) == 1 && repeat > 0;
+		else if (ok && !std::strcmp(arg, "-c")) ok = std::sscanf(value, "%f", &voxel) == 1 && voxel > 0.0f;
+		else if (ok && !std::strcmp(arg, "-x")) ok = std::sscanf(value, "%f", &settings.relaxation) == 1 && settings.relaxation >= 1.0f && settings.relaxation < 2.0f;
+		else if (ok && !std::strcmp(arg, "-m")) ok = std::sscanf(value, "%d", &settings.max_steps) == 1 && settings.max_steps > 0;
+		else if (ok && !std::strcmp(arg, "-e")) ok = std::sscanf(value, "%f", &footprints) == 1 && footprints >= 0.0f;
+		else if (ok && !std::strcmp(arg, "-a")) ok = std::sscanf(value, "%d", &edge_samples) == 1 && edge_samples >= 0;
+		else ok = false;
+		if (!ok) {
+			usage(argv[0]);
+			return 1;
+		}
+		++i;
+	}
+	
+	// the video goes to stdout, so the log has to get out of its way
+	if (output == "-") spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
+	
+	PerspectiveCamera camera{};
+	camera.pose(position, rotation);
+	settings.pixel_cone = footprints * camera.footprint(width);
+	set_march_settings(settings);
+	// shadow cache cells span about two pixels
+	if (lighting.cache_cell > 0.0f) lighting.cache_cell = 2.0f * camera.footprint(width);
+	lighting.eye = camera.origin();
+	set_lighting_settings(lighting);
+	std::shared_ptr<CompiledObject> object{};
+	std::vector<CameraKey> path{ { 0.0f, position, rotation } };
+	try {
+		if (!cameraPath.empty()) path = load_camera_path(cameraPath);
+		const auto loadStart = now();
+		// the renderers only read bytecode, so the scene goes straight from its graph to a program
+		object = std::make_shared<CompiledObject>((input.empty() ? demo_scene_graph() : load_scene_graph(input)).compile());
+		if (!input.empty())
+			spdlog::info("Loaded {} in {:.3f} ms", input, std::chrono::duration<double, std::milli>(now() - loadStart).count());
+	}
+	catch (const std::exception& e) {
+		spdlog::error("{}", e.what());
+		return 1;
+	}
+	Framebuffer fb{ width, height };
+	fb.encoding = encoding;
+	
+	BrickMap cache{};
+	if (voxel > 0.0f) {
+		// its threads are gone again before the tile workers fork
+		TaskPool builders{ threads ? threads : TaskPool::default_threads() };
+		const auto buildStart = now();
+		try {
+			cache = BrickMap::build(*object, voxel, builders);
+		}
+		catch (const std::exception& e) {
+			spdlog::error("{}", e.what());
+			return 1;
+		}
+		spdlog::info("Built brick map with {} bricks ({} KiB) in {:.3f} ms",
+			std::count_if(cache.bricks.begin(), cache.bricks.end(), [](auto b) { return b >= 0; }),
+			cache.memory() / 1024, std::chrono::duration<double, std::milli>(now() - buildStart).count());
+	}
+	const auto fixedScene = fixed_demo_scene();
+	if (fixed && (!input.empty() || voxel > 0.0f)) spdlog::warn("-F renders the built-in demo scene without a brick map");
+	
+	if (workerCount > 0 && (reproject || accumulate)) {
+		// both keep per-pixel history that would end up spread over the workers
+		spdlog::warn("Tile workers ignore -T and -A");
+		reproject = accumulate = false;
+	}
+	
+	Reprojection temporal{ width, height };
+	Accumulation accumulation{ width, height };
+	RenderOptions options{};
+	options.temporal = reproject ? &temporal : nullptr;
+	options.edge_samples = edge_samples;
+	options.accumulation = accumulate ? &accumulation : nullptr;
+	options.heatmap = heatmap;
+	
+	constexpr int tile = 16, workerTile = 64;
+	// pixels [x, x + w) x [y, y + h) of `target`, traced the way the options ask for
+	const auto renderTile = [&](Framebuffer& target, int x, int y, int w, int h) {
+		if (fixed) {
+			render(target, camera, fixedScene, y, h, x, w);
+			return;
+		}
+		if (cache.empty()) {
+			render(target, camera, object, y, h, x, w, options);
+			return;
+		}
+		w = std::min(w, width - x), h = std::min(h, height - y);
+		std::vector<Color> colors(std::size_t(w) * h);
+		trace_region(cache, object, camera, width, height, x, y, w, h, colors.data());
+		for (int row = 0; row < h; ++row)
+			target.store(x, y + row, &colors[std::size_t(row) * w], std::size_t(w));
+	};
+	std::unique_ptr<TileWorkers> workers{};
+	if (workerCount > 0) {
+		const std::size_t workerThreads = threads ? threads : std::max<std::size_t>(1, TaskPool::default_threads() / std::size_t(workerCount));
+		// each worker starts its own pool on the first tile, the forked process has no other threads
+		TileWorkers::Renderer serve = [&, pool = std::shared_ptr<TaskPool>{}, posed = 0](Framebuffer& target, const Tile& t) mutable {
+			if (!pool) pool = std::make_shared<TaskPool>(workerThreads);
+			if (frames > 0 && t.frame != posed) {
+				const auto key = camera_at(path, float(t.frame));
+				camera.pose(key.position, key.rotation);
+				auto settings = lighting_settings();
+				settings.eye = camera.origin();
+				set_lighting_settings(settings);
+				posed = t.frame;
+			}
+			const int columns = (t.width + tile - 1) / tile, rows = (t.height + tile - 1) / tile;
+			pool->run(std::size_t(columns * rows), [&](std::size_t i) {
+				const int x = t.x + int(i) % columns * tile, y = t.y + int(i) / columns * tile;
+				const int w = std::min(tile, t.x + t.width - x), h = std::min(tile, t.y + t.height - y);
+				// animations trace the compiled scene only, like render_sequence() does
+				if (frames > 0) render(target, camera, object, y, h, x, w, options);
+				else renderTile(target, x, y, w, h);
+			});
+		};
+		if (frames > 0) {
+			const auto key = camera_at(path, 0.0f);
+			camera.pose(key.position, key.rotation);
+			lighting.eye = camera.origin();
+			set_lighting_settings(lighting);
+		}
+		try {
+			workers = std::make_unique<TileWorkers>(std::size_t(workerCount), width, height, encoding, serve);
+		}
+		catch (const std::exception& e) {
+			spdlog::critical("{}", e.what());
+			return 1;
+		}
+	}
+	TaskPool pool{ threads ? threads : TaskPool::default_threads() };
+	
+	set_profiling(!profile.empty());
+	if (frames > 0) {
+		if (voxel > 0.0f || fixed || accumulate) spdlog::warn("Animations ignore -c, -F and -A");
+		const bool ok = render_sequence(object, path, frames, width, height, output, fps, encoding, pool, workers.get(), options);
+		if (!profile.empty()) {
+			set_profiling(false);
+			log_profile();
+			if (!write_chrome_trace(profile)) spdlog::error("Failed to write {}", profile);
+		}
+		return ok ? 0 : 1;
+	}
+	const int tilesX = (width + tile - 1) / tile, tilesY = (height + tile - 1) / tile;
+	const auto start = now();
+	for (int n = 0; n < repeat; ++n) {
+		profile_frame(std::uint64_t(n));
+		ProfileScope frameScope{ Stage::Frame };
+		if (workers) {
+			if (!workers->render(fb, workerTile)) {
+				spdlog::critical("All tile workers failed");
+				return 1;
+			}
+			continue;
+		}
+		if (reproject)
+			temporal.begin_frame(camera, pool);
+		pool.run(std::size_t(tilesX * tilesY), [&](std::size_t i) {
+			renderTile(fb, int(i) % tilesX * tile, int(i) / tilesX * tile, tile, tile);
+			flush_evaluations();
+		});
+		accumulation.advance();
+	}
+	const auto seconds = std::chrono::duration<double>(now() - start).count() / repeat;
+	spdlog::info("Rendered {}x{} on {} in {:.3f} ms ({:.2f} Mrays/s)",
+		width, height, workers ? fmt::format("{} workers", workers->size()) : fmt::format("{} threads", pool.size()), seconds * 1000.0, double(width) * height / seconds / 1e6);
+	if (!profile.empty()) {
+		set_profiling(false);
+		log_profile();
+		if (!write_chrome_trace(profile)) spdlog::error("Failed to write {}", profile);
+	}
+	
+	if (statistics) {
+		// plain marches from the camera, without cone or reprojected starts, through the brick map with -c
+		std::vector<int> steps;
+		std::array<std::size_t, 3> ends{};
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				const auto ray = camera.project((float(x) + 0.5f) / float(width), (float(y) + 0.5f) / float(height));
+				const auto result = cache.empty() ? march(object->program, ray) : march(cache, object->program, ray);
+				steps.push_back(result.steps);
+				++ends[std::size_t(result.end)];
+			}
+		}
+		std::sort(steps.begin(), steps.end());
+		spdlog::info("Steps per ray: mean {:.2f}, median {}, p99 {}, max {}",
+			double(std::accumulate(steps.begin(), steps.end(), std::size_t(0))) / double(steps.size()),
+			steps[steps.size() / 2], steps[steps.size() * 99 / 100], steps.back());
+		spdlog::info("Rays: {} hit, {} sky, {} step limit", ends[std::size_t(MarchEnd::Hit)],
+			ends[std::size_t(MarchEnd::Sky)], ends[std::size_t(MarchEnd::StepLimit)]);
+	}
+	
+	if (!fb.write(output)) {
+		spdlog::critical("Failed to write {}", output);
+		return 1;
+	}
+	return 0;
+}
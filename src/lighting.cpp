@@ -0,0 +1,65 @@
+#include <vector>
+#include "lighting.hpp"
+
+namespace sdf {
+	static LightingSettings settings{};
+	
+	const LightingSettings& lighting_settings() noexcept { return settings; }
+	void set_lighting_settings(const LightingSettings& s) noexcept { settings = s; }
+	
+	namespace {
+		struct ShadowEntry {
+			std::uint64_t key = 0;
+			Ray ray{};
+			float slack = 0.0f;
+		};
+		constexpr std::size_t shadow_cache_size = 4096;
+		
+		// Cells grow with the distance to the camera and cover about the same number of pixels everywhere.
+		// Their sizes are powers of two to keep neighbours in one cell.
+		[[nodiscard]]
+		std::uint64_t shadow_key(std::uint64_t scene, vec3 p) noexcept {
+			int level;
+			std::frexp(std::max(settings.cache_cell * glm::length(p - settings.eye), 1e-6f), &level);
+			const vec3 cell = glm::floor(p * std::ldexp(1.0f, -level));
+			std::uint64_t key = scene * 0x9E3779B97F4A7C15u ^ std::uint64_t(std::uint32_t(level));
+			for (int i = 0; i < 3; ++i)
+				key = (key ^ std::uint64_t(std::uint32_t(std::int32_t(cell[i])))) * 0xFF51AFD7ED558CCDu;
+			return key | 1;
+		}
+		[[nodiscard]]
+		ShadowEntry& shadow_slot(std::uint64_t key) {
+			thread_local std::vector<ShadowEntry> entries(shadow_cache_size);
+			return entries[(key >> 20) % shadow_cache_size];
+		}
+	}
+	
+	bool shadow_cache_lookup(std::uint64_t scene, const Ray& ray) noexcept {
+		if (settings.cache_cell <= 0.0f) return false;
+		const auto key = shadow_key(scene, ray.origin);
+		const auto& entry = shadow_slot(key);
+		return entry.key == key && entry.ray.direction == ray.direction && glm::length(entry.ray.origin - ray.origin) <= entry.slack;
+	}
+	void shadow_cache_store(std::uint64_t scene, const Ray& ray, float slack) noexcept {
+		if (settings.cache_cell <= 0.0f) return;
+		const auto key = shadow_key(scene, ray.origin);
+		shadow_slot(key) = { key, ray, slack };
+	}
+	
+	Bounds lighting_reach(const Bounds& box, vec3 light, const LightingSettings& settings) noexcept {
+		Bounds reach = box;
+		// shadow rays leave up to bias off the surface and reach shadow_distance towards the light,
+		// at t along the ray anything nearer than t / penumbra darkens the penumbra
+		if (settings.shadows) {
+			const vec3 back = glm::normalize(light) * (settings.shadow_distance + settings.bias);
+			reach = merge(reach, { box.lower - back, box.upper - back });
+			const float spread = settings.bias + settings.shadow_distance / settings.penumbra;
+			reach = { reach.lower - spread, reach.upper + spread };
+		}
+		if (settings.occlusion) {
+			const float radius = 0.01f + settings.occlusion_radius;
+			reach = { reach.lower - radius, reach.upper + radius };
+		}
+		return reach;
+	}
+}
@@ -1,10 +1,20 @@
 #include <SDL2/SDL.h>
+#include <spdlog/spdlog.h>
 #include <numeric>
 #include <thread>
 #include <array>
+#include <charconv>
+#include <string>
 #include "object.hpp"
 #include "shader.hpp"
 #include "raytracer.hpp"
+#include "scheduler.hpp"
+#include "reprojection.hpp"
+#include "governor.hpp"
+#include "region.hpp"
+#include "lighting.hpp"
+#include "profiler.hpp"
+#include "scene.hpp"
 #include "screen.hpp"
 
 
@@ -12,73 +22,189 @@ using namespace sdf;
 using namespace std::chrono_literals;
 
 static PerspectiveCamera camera{};
-static std::shared_ptr<Object> scene{};
+static SceneGraph scene{};
 
 static auto now() { return std::chrono::high_resolution_clock::now(); }
 
-static void do_render(volatile float* fps = nullptr, int yoff = 0, int ysize = INT32_MAX) {
-	SDL_Surface* surface = createSubSurface(ysize);
-	const auto translation = std::make_shared<Translation>(scene, camera_pos);
-	const auto rotationY = std::make_shared<RotationY>(translation, camera_rotation.y);
-	const auto rotation = std::make_shared<RotationX>(rotationY, camera_rotation.x);
+// Writes the frames profiled since profiling was switched on.
+static void finish_profile(const char* path) {
+	set_profiling(false);
+	log_profile();
+	if (write_chrome_trace(path)) spdlog::info("Wrote {}", path);
+	else spdlog::error("Failed to write {}", path);
+}
+
+// First translated member of the scene's top level unions, the node F4 moves around.
+static NodeId find_translation(const SceneGraph& graph, NodeId id) {
+	if (id == no_node) return no_node;
+	const auto& node = graph[id];
+	if (node.kind == NodeKind::Translation) return id;
+	if (node.kind != NodeKind::Union) return no_node;
+	const auto t = find_translation(graph, node.first);
+	return t != no_node ? t : find_translation(graph, node.second);
+}
+
+static void do_render(TaskPool& pool, float target_fps) {
+	constexpr int tile = 16, edge_samples = 4;
+	// tiles that rendered this many passes since they last changed are left alone, the renderer idles once all of them are
+	constexpr std::uint32_t converged_passes = 32;
+	constexpr float heatmap_scale = 256.0f;
+	constexpr const char* trace_path = "sdf-trace.json";
+	const auto [w, h] = surfaceSize();
+	FrameGovernor governor{ target_fps };
+	std::unique_ptr<Reprojection> temporal;
+	std::unique_ptr<Accumulation> accumulation;
+	std::unique_ptr<FrameHistory> history;
+	auto compiled = std::make_shared<CompiledObject>(scene.compile());
+	const auto mover = find_translation(scene, scene.root);
+	const Node home = mover != no_node ? scene[mover] : Node{};
+	std::vector<std::uint32_t> passes{};
+	std::vector<std::size_t> tiles{};
+	FrameState last = acquire_frame_state();
 	auto lastFrame = now();
-	while (!quit_requested) {
+	for (std::size_t frame = 0; !quit_requested;) {
 		const auto curFrame = now();
-		const float diff = std::chrono::duration_cast<std::chrono::microseconds>(curFrame - lastFrame).count() / 1'000'000.f;
-		if (fps) *fps = 1.0f / diff; else set_fps(1.0f / diff);
 		
-		translation->translation = camera_pos;
-		rotationY->update(camera_rotation.y);
-		rotation->update(camera_rotation.x);
+		// every tile of a frame renders the same snapshot
+		const FrameState state = acquire_frame_state();
+		if (state.profiling && !profiling()) {
+			reset_profile();
+			set_profiling(true);
+		}
+		else if (!state.profiling && profiling())
+			finish_profile(trace_path);
+		
+		const auto quality = governor.quality();
+		const int rw = std::max(1, int(float(w) * quality.scale)), rh = std::max(1, int(float(h) * quality.scale));
+		bool full = quality.scale != 1.0f || quality.checkerboard;
+		if (!temporal || temporal->width() != rw || temporal->height() != rh) {
+			resize_frame(rw, rh);
+			temporal = std::make_unique<Reprojection>(rw, rh);
+			accumulation = std::make_unique<Accumulation>(rw, rh);
+			history = std::make_unique<FrameHistory>(rw, rh);
+			auto settings = march_settings();
+			settings.pixel_cone = camera.footprint(rw);
+			set_march_settings(settings);
+			auto lighting = lighting_settings();
+			lighting.cache_cell = 2.0f * camera.footprint(rw);
+			set_lighting_settings(lighting);
+			full = true;
+		}
+		const int tilesX = (rw + tile - 1) / tile, tilesY = (rh + tile - 1) / tile;
+		passes.resize(std::size_t(tilesX * tilesY));
+		
+		if (mover != no_node && state.animate) {
+			auto node = home;
+			node.params[1] += 0.5f * std::sin(2.0f * state.time);
+			scene.update(mover, node);
+		}
+		const auto edits = scene.changes();
+		scene.commit_changes();
+		// the scene is only recompiled when it changes
+		if (state.scene_version != last.scene_version || edits)
+			compiled = std::make_shared<CompiledObject>(scene.compile());
+		const bool moved = state.position != last.position || state.rotation != last.rotation || state.scene_version != last.scene_version;
+		full |= moved || state.heatmap != last.heatmap;
+		if (moved || state.heatmap != last.heatmap)
+			history->reset();
+		camera.pose(state.position, state.rotation);
+		auto lighting = lighting_settings();
+		lighting.eye = camera.origin();
+		set_lighting_settings(lighting);
+		
+		// an edit only invalidates the tiles that can see it or its shadow, rounded out to whole tiles
+		PixelRect changed{};
+		if (edits) {
+			changed = camera.screen_bounds(lighting_reach(*edits, compiled->sampleDirectionalLight().first, lighting), rw, rh);
+			if (changed.empty()) changed = {};
+			else changed = { changed.x0 / tile * tile, changed.y0 / tile * tile, (changed.x1 + tile - 1) / tile * tile, (changed.y1 + tile - 1) / tile * tile };
+			// checkerboard frames are full ones, but still fill from the history outside of the edit
+			history->reset(changed.x0, changed.y0, changed.x1, changed.y1);
+		}
+		if (full) {
+			accumulation->reset();
+			std::fill(passes.begin(), passes.end(), 0);
+		}
+		else {
+			for (int ty = changed.y0 / tile; ty < changed.y1 / tile; ++ty) {
+				for (int tx = changed.x0 / tile; tx < changed.x1 / tile; ++tx) {
+					passes[std::size_t(ty * tilesX + tx)] = 0;
+					accumulation->reset(tx * tile, ty * tile, tx * tile + tile, ty * tile + tile);
+				}
+			}
+		}
+		tiles.clear();
+		for (std::size_t i = 0; i < passes.size(); ++i)
+			if (passes[i] < converged_passes) tiles.push_back(i);
+		last = state;
+		if (tiles.empty()) {
+			std::this_thread::sleep_for(5ms);
+			lastFrame = now();
+			continue;
+		}
+		
+		const float diff = std::chrono::duration_cast<std::chrono::microseconds>(curFrame - lastFrame).count() / 1'000'000.f;
+		set_fps(1.0f / diff);
+		profile_frame(frame);
+		ProfileScope frameScope{ Stage::Frame };
+		RenderOptions options{};
+		options.temporal = temporal.get();
+		options.checkerboard = quality.checkerboard ? int(frame & 1) : -1;
+		// edge rays only pay off at full resolution, a still view keeps refining every pixel
+		options.edge_samples = quality.scale == 1.0f ? edge_samples : 0;
+		options.accumulation = accumulation.get();
+		options.history = state.heatmap ? nullptr : history.get();
+		options.heatmap = state.heatmap ? heatmap_scale : 0.0f;
+		temporal->begin_frame(camera, pool);
+		// depths remembered from before the edit may lie past the moved object
+		if (!changed.empty())
+			temporal->discard(changed.x0, changed.y0, changed.x1, changed.y1);
 		
-		//render(camera, rotation, yoff, ysize);
-		renderSurface(surface, camera, rotation, yoff, ysize);
-		blit(surface, 0, yoff);
+		pool.run(tiles.size(), [&](std::size_t i) {
+			const int tx = int(tiles[i]) % tilesX, ty = int(tiles[i]) / tilesX;
+			render(camera, compiled, ty * tile, tile, tx * tile, tile, options);
+			flush_evaluations();
+		});
+		{
+			ProfileScope scope{ Stage::Present };
+			present_frame();
+		}
+		if (options.checkerboard < 0)
+			accumulation->advance();
+		for (const auto i : tiles)
+			++passes[i];
 		
+		const float seconds = std::chrono::duration<float>(now() - curFrame).count();
+		governor.update(seconds, moved);
 		lastFrame = curFrame;
+		++frame;
 	}
-	SDL_FreeSurface(surface);
 }
 
+// Positive number from the command line, malformed values fall back to `fallback` with a warning.
+template<typename T>
+static T parse_positive(const char* text, T fallback, const char* what) {
+	T value{};
+	const char* end = text + std::char_traits<char>::length(text);
+	const auto [last, error] = std::from_chars(text, end, value);
+	if (error == std::errc{} && last == end && value > T{}) return value;
+	spdlog::warn("Ignoring {} '{}', using {}", what, text, fallback);
+	return fallback;
+}
 
-#define MULTI 1
-int main() {
-	constexpr int div = 4;
-	constexpr int w = 640 / div, h = 360 / div;
-	std::thread screen_thread(init_screen, w, h, 4);
-	auto shader = std::make_shared<sdf::ShaderLambertian>(Color{ 0.1f, 0.1f, 0.9f, 1.0f });
-	auto cube = std::make_shared<sdf::Cube>(1.0f, shader);
-	auto obj = std::make_shared<sdf::Translation>(cube, vec3{ 1.8f, 0.0f, -10.0f });
-	auto obj2 = std::make_shared<sdf::Translation>(cube, vec3{ 0.0f, 0.0f, -10.0f });
-	auto obj3 = std::make_shared<sdf::Translation>(cube, vec3{ 1.8f, 1.0f, -10.0f });
-	auto obj4 = std::make_shared<sdf::Translation>(cube, vec3{ 0.0f, 1.0f, -10.0f });
-	scene = std::make_shared<Union>(std::make_shared<Union>(obj, obj2), std::make_shared<Union>(obj3, obj4));
+int main(int argc, char** argv) {
+	// the governor lowers the internal resolution below this whenever frames take too long
+	constexpr int w = 640, h = 360;
+	const std::size_t num_threads = argc > 1 ? parse_positive(argv[1], TaskPool::default_threads(), "thread count") : TaskPool::default_threads();
+	const float target_fps = argc > 2 ? parse_positive(argv[2], 30.0f, "target frame rate") : 30.0f;
+	scene = argc > 3 ? load_scene_graph(argv[3]) : demo_scene_graph();
+	std::thread screen_thread(init_screen, w, h, 2);
 	while (!screen_initialized());
-
-#if MULTI
-	constexpr size_t num_threads = 4;
-	std::array<std::thread, num_threads> renderer{};
-	std::array<volatile float, num_threads> fps{};
 	
-	for (size_t i = 0; i < renderer.size(); ++i) {
-		const float ysize = ((float)h / (float)renderer.size());
-		const float yoff = ysize * (float)i;
-		renderer[i] = std::thread(do_render, &fps[i], (int)yoff, (int)std::ceil(ysize));
-	}
-	
-	while (!quit_requested) {
-		set_fps(std::accumulate(fps.begin(), fps.end(), 0.0f) / fps.size());
-		std::this_thread::sleep_for(10ms);
-	}
-	
-	for (auto& r : renderer) {
-		r.join();
-	}
-#else
-	do_render();
-#endif
+	TaskPool pool{ num_threads };
+	do_render(pool, target_fps);
 	
 	quit_requested = false;
 	screen_thread.join();
 	return 0;
-}
\ No newline at end of file
+}
@@ -1,27 +1,36 @@
 #include "object.hpp"
+#include "program.hpp"
+#include "primitives.hpp"
+#include "lighting.hpp"
+#include "march.hpp"
 
 namespace sdf {
 	vec3 Object::normal(vec3 p) const noexcept {
-		constexpr float v = 0.001f;
-		const auto x = (*this)({ p.x + v, p.y, p.z }).first - (*this)({ p.x - v, p.y, p.z }).first;
-		const auto y = (*this)({ p.x, p.y + v, p.z }).first - (*this)({ p.x, p.y - v, p.z }).first;
-		const auto z = (*this)({ p.x, p.y, p.z + v }).first - (*this)({ p.x, p.y, p.z - v }).first;
-		return glm::normalize(vec3{ x, y, z });
+		return glm::normalize(gradient(p));
+	}
+	vec3 Object::gradient(vec3 p) const noexcept {
+		return tetrahedral_gradient([this](vec3 q) { return (*this)(q).first; }, p);
 	}
 	std::pair<vec3, vec3> Object::sampleDirectionalLight() const noexcept {
 		return { { -1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }};
 	}
+	float Object::shadow(vec3 p, vec3 n, vec3 light) const noexcept {
+		const auto& settings = lighting_settings();
+		if (!settings.shadows) return 1.0f;
+		const Ray ray{ p + n * settings.bias, light };
+		const float far = std::min(settings.shadow_distance, exit_distance(bounds(), ray));
+		return soft_shadow([this](vec3 q) { return (*this)(q).first; }, ray, far, settings).visibility;
+	}
+	float Object::occlusion(vec3 p, vec3 n) const noexcept {
+		const auto& settings = lighting_settings();
+		if (!settings.occlusion) return 1.0f;
+		return ambient_occlusion([this](vec3 q) { return (*this)(q).first; }, p, n, settings);
+	}
 	std::pair<float, std::shared_ptr<Shader>> Sphere::operator()(const vec3& p) const {
-		return { glm::length(p) - radius, shader };
+		return { sphere_distance(p, radius), shader };
 	}
 	std::pair<float, std::shared_ptr<Shader>> Cube::operator()(const vec3& p) const {
-		const float dx = std::abs(p.x) - a / 2, dx0 = std::max(0.0f, dx);
-		const float dy = std::abs(p.y) - a / 2, dy0 = std::max(0.0f, dy);
-		const float dz = std::abs(p.z) - a / 2, dz0 = std::max(0.0f, dz);
-		
-		const float inner = std::min(0.0f, std::max({ dx, dy, dz }));
-		const float outer = std::sqrt(dx0 * dx0 + dy0 * dy0 + dz0 * dz0);
-		return { inner + outer, shader };
+		return { cube_distance(p, a), shader };
 	}
 	vec3 Object::center() const noexcept { return { 0.0f, 0.0f, 0.0f }; }
 	vec3 Translation::center() const noexcept { return object->center() + translation; }
@@ -30,6 +39,143 @@ namespace sdf {
 	vec3 Union::center() const noexcept { return (obj1->center() + obj2->center()) / 2.0f; }
 	vec3 Intersection::center() const noexcept { return (obj1->center() + obj2->center()) / 2.0f; }
 	vec3 Subtraction::center() const noexcept { return (obj1->center() + obj2->center()) / 2.0f; }
+	vec3 Affine::center() const noexcept { return world(object->center()); }
+	vec3 SmoothUnion::center() const noexcept { return (obj1->center() + obj2->center()) / 2.0f; }
+	vec3 SmoothIntersection::center() const noexcept { return (obj1->center() + obj2->center()) / 2.0f; }
+	vec3 SmoothSubtraction::center() const noexcept { return (obj1->center() + obj2->center()) / 2.0f; }
+	vec3 Instances::center() const noexcept {
+		vec3 sum{};
+		for (const auto& offset : offsets)
+			sum += offset;
+		return object->center() + (offsets.empty() ? sum : sum / float(offsets.size()));
+	}
+	
+	// Bounds of the box after mapping each of its corners with f.
+	Bounds Object::bounds() const noexcept { return {}; }
+	Bounds Sphere::bounds() const noexcept { return { vec3{ -radius }, vec3{ radius } }; }
+	Bounds Cube::bounds() const noexcept { return { vec3{ -a / 2 }, vec3{ a / 2 } }; }
+	Bounds Translation::bounds() const noexcept {
+		const auto b = object->bounds();
+		return { b.lower + translation, b.upper + translation };
+	}
+	Bounds rotate_x_bounds(const Bounds& b, float sinr, float cosr) noexcept {
+		return transform_bounds(b, [=](vec3 p) { return vec3{ p.x, cosr * p.y + sinr * p.z, cosr * p.z - sinr * p.y }; });
+	}
+	Bounds rotate_y_bounds(const Bounds& b, float sinr, float cosr) noexcept {
+		return transform_bounds(b, [=](vec3 p) { return vec3{ cosr * p.x + sinr * p.z, p.y, cosr * p.z - sinr * p.x }; });
+	}
+	Bounds RotationX::bounds() const noexcept { return rotate_x_bounds(object->bounds(), sinr, cosr); }
+	Bounds RotationY::bounds() const noexcept { return rotate_y_bounds(object->bounds(), sinr, cosr); }
+	Bounds Union::bounds() const noexcept { return merge(obj1->bounds(), obj2->bounds()); }
+	Bounds Intersection::bounds() const noexcept { return intersect(obj1->bounds(), obj2->bounds()); }
+	Bounds Subtraction::bounds() const noexcept { return obj1->bounds(); }
+	Bounds affine_bounds(const Affine& affine, const Bounds& b) noexcept {
+		return transform_bounds(b, [&affine](vec3 p) { return affine.world(p); });
+	}
+	Bounds Affine::bounds() const noexcept { return affine_bounds(*this, object->bounds()); }
+	// every copy of b
+	Bounds repeat_bounds(Bounds b, vec3 period, vec3 limit) noexcept {
+		for (int i = 0; i < 3; ++i) {
+			if (period[i] == 0.0f) continue;
+			b.lower[i] -= std::abs(period[i]) * limit[i];
+			b.upper[i] += std::abs(period[i]) * limit[i];
+		}
+		return b;
+	}
+	Bounds mirror_bounds(Bounds b, const bool* axes) noexcept {
+		for (int i = 0; i < 3; ++i) {
+			if (!axes[i]) continue;
+			b.upper[i] = std::max(std::abs(b.lower[i]), std::abs(b.upper[i]));
+			b.lower[i] = -b.upper[i];
+		}
+		return b;
+	}
+	Bounds Repetition::bounds() const noexcept { return repeat_bounds(object->bounds(), period, limit); }
+	Bounds Mirror::bounds() const noexcept { return mirror_bounds(object->bounds(), axes); }
+	// the blend bulges out by at most k / 4
+	Bounds SmoothUnion::bounds() const noexcept {
+		const auto b = merge(obj1->bounds(), obj2->bounds());
+		return { b.lower - k * 0.25f, b.upper + k * 0.25f };
+	}
+	Bounds SmoothIntersection::bounds() const noexcept { return intersect(obj1->bounds(), obj2->bounds()); }
+	Bounds SmoothSubtraction::bounds() const noexcept { return obj1->bounds(); }
+	Bounds instance_bounds(const Bounds& b, std::span<const vec3> offsets) noexcept {
+		if (offsets.empty()) return { vec3{ 0.0f }, vec3{ 0.0f } };
+		if (!b.finite()) return b;
+		Bounds r{ offsets.front(), offsets.front() };
+		for (const auto& offset : offsets)
+			r = merge(r, { offset, offset });
+		return { r.lower + b.lower, r.upper + b.upper };
+	}
+	Bounds Instances::bounds() const noexcept { return instance_bounds(object->bounds(), offsets); }
+	
+	void Object::touch(const Bounds& before) noexcept {
+		const auto b = merge(before, bounds());
+		changed = changed ? merge(*changed, b) : b;
+	}
+	std::optional<Bounds> Object::changes() const { return changed; }
+	void Object::commit_changes() noexcept { changed.reset(); }
+	
+	[[nodiscard]]
+	static std::optional<Bounds> merge(const std::optional<Bounds>& a, const std::optional<Bounds>& b) noexcept {
+		if (!a) return b;
+		if (!b) return a;
+		return merge(*a, *b);
+	}
+	// Changes below a node map into its space like its bounds do.
+	template<class F>
+	[[nodiscard]]
+	static std::optional<Bounds> map(const std::optional<Bounds>& changes, F f) {
+		if (!changes) return std::nullopt;
+		return f(*changes);
+	}
+	// a change to either side reshapes the blend up to k around it
+	[[nodiscard]]
+	static std::optional<Bounds> blend_changes(const Object& obj1, const Object& obj2, float k) {
+		return map(merge(obj1.changes(), obj2.changes()), [k](const Bounds& b) { return Bounds{ b.lower - k, b.upper + k }; });
+	}
+	std::optional<Bounds> Translation::changes() const {
+		return merge(Object::changes(), map(object->changes(), [this](const Bounds& b) { return Bounds{ b.lower + translation, b.upper + translation }; }));
+	}
+	std::optional<Bounds> RotationX::changes() const {
+		return merge(Object::changes(), map(object->changes(), [this](const Bounds& b) { return rotate_x_bounds(b, sinr, cosr); }));
+	}
+	std::optional<Bounds> RotationY::changes() const {
+		return merge(Object::changes(), map(object->changes(), [this](const Bounds& b) { return rotate_y_bounds(b, sinr, cosr); }));
+	}
+	std::optional<Bounds> Union::changes() const { return merge(Object::changes(), merge(obj1->changes(), obj2->changes())); }
+	std::optional<Bounds> Intersection::changes() const { return merge(Object::changes(), merge(obj1->changes(), obj2->changes())); }
+	std::optional<Bounds> Subtraction::changes() const { return merge(Object::changes(), merge(obj1->changes(), obj2->changes())); }
+	std::optional<Bounds> Affine::changes() const {
+		return merge(Object::changes(), map(object->changes(), [this](const Bounds& b) { return affine_bounds(*this, b); }));
+	}
+	std::optional<Bounds> Repetition::changes() const {
+		return merge(Object::changes(), map(object->changes(), [this](const Bounds& b) { return repeat_bounds(b, period, limit); }));
+	}
+	std::optional<Bounds> Mirror::changes() const {
+		return merge(Object::changes(), map(object->changes(), [this](const Bounds& b) { return mirror_bounds(b, axes); }));
+	}
+	std::optional<Bounds> SmoothUnion::changes() const { return merge(Object::changes(), blend_changes(*obj1, *obj2, k)); }
+	std::optional<Bounds> SmoothIntersection::changes() const { return merge(Object::changes(), blend_changes(*obj1, *obj2, k)); }
+	std::optional<Bounds> SmoothSubtraction::changes() const { return merge(Object::changes(), blend_changes(*obj1, *obj2, k)); }
+	std::optional<Bounds> Instances::changes() const {
+		return merge(Object::changes(), map(object->changes(), [this](const Bounds& b) { return instance_bounds(b, offsets); }));
+	}
+	
+	// shared objects are visited once per parent, which is harmless
+	void Translation::commit_changes() noexcept { Object::commit_changes(), object->commit_changes(); }
+	void RotationX::commit_changes() noexcept { Object::commit_changes(), object->commit_changes(); }
+	void RotationY::commit_changes() noexcept { Object::commit_changes(), object->commit_changes(); }
+	void Union::commit_changes() noexcept { Object::commit_changes(), obj1->commit_changes(), obj2->commit_changes(); }
+	void Intersection::commit_changes() noexcept { Object::commit_changes(), obj1->commit_changes(), obj2->commit_changes(); }
+	void Subtraction::commit_changes() noexcept { Object::commit_changes(), obj1->commit_changes(), obj2->commit_changes(); }
+	void Affine::commit_changes() noexcept { Object::commit_changes(), object->commit_changes(); }
+	void Repetition::commit_changes() noexcept { Object::commit_changes(), object->commit_changes(); }
+	void Mirror::commit_changes() noexcept { Object::commit_changes(), object->commit_changes(); }
+	void SmoothUnion::commit_changes() noexcept { Object::commit_changes(), obj1->commit_changes(), obj2->commit_changes(); }
+	void SmoothIntersection::commit_changes() noexcept { Object::commit_changes(), obj1->commit_changes(), obj2->commit_changes(); }
+	void SmoothSubtraction::commit_changes() noexcept { Object::commit_changes(), obj1->commit_changes(), obj2->commit_changes(); }
+	void Instances::commit_changes() noexcept { Object::commit_changes(), object->commit_changes(); }
 	
 	std::pair<float, std::shared_ptr<Shader>> Translation::operator()(const vec3& p) const {
 		return (*object)(p - translation);
@@ -60,15 +206,278 @@ namespace sdf {
 		b.first = -b.first;
 		return a.first > b.first ? a : b;
 	}
+	std::pair<float, std::shared_ptr<Shader>> Affine::operator()(const vec3& p) const {
+		const auto [d, shader] = (*object)(local(p));
+		return { d * scale, shader };
+	}
+	std::pair<float, std::shared_ptr<Shader>> Repetition::operator()(const vec3& p) const {
+		return (*object)(repeat_point(p, period, limit));
+	}
+	std::pair<float, std::shared_ptr<Shader>> Mirror::operator()(const vec3& p) const {
+		return (*object)(vec3{ axes[0] ? std::abs(p.x) : p.x, axes[1] ? std::abs(p.y) : p.y, axes[2] ? std::abs(p.z) : p.z });
+	}
+	std::pair<float, std::shared_ptr<Shader>> SmoothUnion::operator()(const vec3& p) const {
+		const auto a = (*obj1)(p);
+		const auto b = (*obj2)(p);
+		return { smooth_min(a.first, b.first, k), a.first < b.first ? a.second : b.second };
+	}
+	std::pair<float, std::shared_ptr<Shader>> SmoothIntersection::operator()(const vec3& p) const {
+		const auto a = (*obj1)(p);
+		const auto b = (*obj2)(p);
+		return { smooth_max(a.first, b.first, k), a.first > b.first ? a.second : b.second };
+	}
+	std::pair<float, std::shared_ptr<Shader>> SmoothSubtraction::operator()(const vec3& p) const {
+		const auto a = (*obj1)(p);
+		const auto b = (*obj2)(p);
+		return { smooth_max(a.first, -b.first, k), a.first > -b.first ? a.second : b.second };
+	}
+	// Copies whose box is further away than the best distance so far are skipped.
+	[[nodiscard]]
+	static std::size_t nearest_instance(const Instances& instances, vec3 p) {
+		const auto b = instances.object->bounds();
+		std::size_t nearest = 0;
+		float best = std::numeric_limits<float>::infinity();
+		for (std::size_t i = 0; i < instances.offsets.size(); ++i) {
+			const vec3 q = p - instances.offsets[i];
+			if (b.finite() && b.distance(q) >= best) continue;
+			const float d = (*instances.object)(q).first;
+			if (d < best) {
+				best = d;
+				nearest = i;
+			}
+		}
+		return nearest;
+	}
+	std::pair<float, std::shared_ptr<Shader>> Instances::operator()(const vec3& p) const {
+		if (offsets.empty()) return { std::numeric_limits<float>::infinity(), nullptr };
+		return (*object)(p - offsets[nearest_instance(*this, p)]);
+	}
+	
+	void Sphere::compile(Program& program) const {
+		program.emit(Opcode::Sphere, radius, 0.0f, 0.0f, program.material(shader));
+	}
+	void Cube::compile(Program& program) const {
+		program.emit(Opcode::Cube, a, 0.0f, 0.0f, program.material(shader));
+	}
+	void Translation::compile(Program& program) const {
+		program.emit(Opcode::Translate, translation.x, translation.y, translation.z);
+		object->compile(program);
+		program.emit(Opcode::Pop);
+	}
+	void RotationX::compile(Program& program) const {
+		program.emit(Opcode::RotateX, sinr, cosr);
+		object->compile(program);
+		program.emit(Opcode::Pop);
+	}
+	void RotationY::compile(Program& program) const {
+		program.emit(Opcode::RotateY, sinr, cosr);
+		object->compile(program);
+		program.emit(Opcode::Pop);
+	}
+	static void collect_union(const Object& obj, std::vector<const Object*>& members) {
+		if (const auto* u = dynamic_cast<const Union*>(&obj)) {
+			collect_union(*u->obj1, members);
+			collect_union(*u->obj2, members);
+		}
+		else members.push_back(&obj);
+	}
+	void Union::compile(Program& program) const {
+		std::vector<const Object*> members{};
+		collect_union(*this, members);
+		if (members.size() >= min_bvh_members) {
+			program.emit_union(std::move(members));
+			return;
+		}
+		obj1->compile(program);
+		obj2->compile(program);
+		program.emit(Opcode::Union);
+	}
+	void Instances::compile(Program& program) const {
+		program.emit_instances(*object, offsets);
+	}
+	void Intersection::compile(Program& program) const {
+		obj1->compile(program);
+		obj2->compile(program);
+		program.emit(Opcode::Intersection);
+	}
+	void Subtraction::compile(Program& program) const {
+		obj1->compile(program);
+		obj2->compile(program);
+		program.emit(Opcode::Subtraction);
+	}
+	void Affine::compile(Program& program) const {
+		program.code.push_back({ Opcode::Affine, 0, { x.x, x.y, x.z, y.x, y.y, y.z } });
+		program.code.push_back({ Opcode::Operand, 0, { z.x, z.y, z.z, offset.x, offset.y, offset.z } });
+		object->compile(program);
+		if (scale != 1.0f) program.emit(Opcode::Scale, scale);
+		program.emit(Opcode::Pop);
+	}
+	void Repetition::compile(Program& program) const {
+		program.code.push_back({ Opcode::Repeat, 0, { period.x, period.y, period.z, limit.x, limit.y, limit.z } });
+		object->compile(program);
+		program.emit(Opcode::Pop);
+	}
+	void Mirror::compile(Program& program) const {
+		program.emit(Opcode::Mirror, float(axes[0]), float(axes[1]), float(axes[2]));
+		object->compile(program);
+		program.emit(Opcode::Pop);
+	}
+	void SmoothUnion::compile(Program& program) const {
+		obj1->compile(program);
+		obj2->compile(program);
+		program.emit(Opcode::SmoothUnion, k);
+	}
+	void SmoothIntersection::compile(Program& program) const {
+		obj1->compile(program);
+		obj2->compile(program);
+		program.emit(Opcode::SmoothIntersection, k);
+	}
+	void SmoothSubtraction::compile(Program& program) const {
+		obj1->compile(program);
+		obj2->compile(program);
+		program.emit(Opcode::SmoothSubtraction, k);
+	}
 	
+	vec3 Sphere::gradient(vec3 p) const noexcept { return sphere_gradient(p); }
+	vec3 Cube::gradient(vec3 p) const noexcept { return cube_gradient(p, a); }
+	vec3 Translation::gradient(vec3 p) const noexcept { return object->gradient(p - translation); }
+	vec3 RotationX::gradient(vec3 p) const noexcept {
+		const vec3 g = object->gradient({ p.x, cosr * p.y - sinr * p.z, sinr * p.y + cosr * p.z });
+		return { g.x, cosr * g.y + sinr * g.z, cosr * g.z - sinr * g.y };
+	}
+	vec3 RotationY::gradient(vec3 p) const noexcept {
+		const vec3 g = object->gradient({ cosr * p.x - sinr * p.z, p.y, sinr * p.x + cosr * p.z });
+		return { cosr * g.x + sinr * g.z, g.y, cosr * g.z - sinr * g.x };
+	}
+	vec3 Union::gradient(vec3 p) const noexcept {
+		return (*obj1)(p).first < (*obj2)(p).first ? obj1->gradient(p) : obj2->gradient(p);
+	}
+	vec3 Intersection::gradient(vec3 p) const noexcept {
+		return (*obj1)(p).first > (*obj2)(p).first ? obj1->gradient(p) : obj2->gradient(p);
+	}
+	vec3 Subtraction::gradient(vec3 p) const noexcept {
+		return (*obj1)(p).first > -(*obj2)(p).first ? obj1->gradient(p) : -obj2->gradient(p);
+	}
+	vec3 Affine::gradient(vec3 p) const noexcept {
+		const vec3 g = object->gradient(local(p));
+		return (g.x * x + g.y * y + g.z * z) * scale;
+	}
+	vec3 Repetition::gradient(vec3 p) const noexcept { return object->gradient(repeat_point(p, period, limit)); }
+	vec3 Mirror::gradient(vec3 p) const noexcept {
+		vec3 q = p;
+		for (int i = 0; i < 3; ++i)
+			if (axes[i]) q[i] = std::abs(q[i]);
+		vec3 g = object->gradient(q);
+		for (int i = 0; i < 3; ++i)
+			if (axes[i] && p[i] < 0.0f) g[i] = -g[i];
+		return g;
+	}
+	// the object that decides the distance contributes 1 - h / 2 of the gradient, the other one h / 2
+	[[nodiscard]]
+	static vec3 blend_gradient(float a, float b, float k, bool first, vec3 ga, vec3 gb) noexcept {
+		const float h = smooth_blend(a, b, k);
+		return first ? (1.0f - 0.5f * h) * ga + 0.5f * h * gb : (1.0f - 0.5f * h) * gb + 0.5f * h * ga;
+	}
+	vec3 SmoothUnion::gradient(vec3 p) const noexcept {
+		const float a = (*obj1)(p).first, b = (*obj2)(p).first;
+		return blend_gradient(a, b, k, a < b, obj1->gradient(p), obj2->gradient(p));
+	}
+	vec3 SmoothIntersection::gradient(vec3 p) const noexcept {
+		const float a = (*obj1)(p).first, b = (*obj2)(p).first;
+		return blend_gradient(a, b, k, a > b, obj1->gradient(p), obj2->gradient(p));
+	}
+	vec3 SmoothSubtraction::gradient(vec3 p) const noexcept {
+		const float a = (*obj1)(p).first, b = -(*obj2)(p).first;
+		return blend_gradient(a, b, k, a > b, obj1->gradient(p), -obj2->gradient(p));
+	}
+	vec3 Instances::gradient(vec3 p) const noexcept {
+		if (offsets.empty()) return {};
+		return object->gradient(p - offsets[nearest_instance(*this, p)]);
+	}
+	
+	// Largest factor by which the matrix with rows x, y and z lengthens a vector, the root of the largest eigenvalue
+	// of the symmetric M M^T by the closed form for 3x3 matrices, in double since rigid maps must come out as 1.
+	[[nodiscard]]
+	static float max_stretch(vec3 x, vec3 y, vec3 z) noexcept {
+		const vec3 rows[3]{ x, y, z };
+		double a[3][3];
+		for (int i = 0; i < 3; ++i)
+			for (int j = 0; j < 3; ++j) a[i][j] = double(rows[i].x) * rows[j].x + double(rows[i].y) * rows[j].y + double(rows[i].z) * rows[j].z;
+		const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+		if (off == 0.0) return float(std::sqrt(std::max({ a[0][0], a[1][1], a[2][2] })));
+		const double q = (a[0][0] + a[1][1] + a[2][2]) / 3.0;
+		const double p = std::sqrt(((a[0][0] - q) * (a[0][0] - q) + (a[1][1] - q) * (a[1][1] - q) + (a[2][2] - q) * (a[2][2] - q) + 2.0 * off) / 6.0);
+		// determinant of (A - qI) / p, halved
+		for (int i = 0; i < 3; ++i) a[i][i] -= q;
+		const double det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+			+ a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+		const double r = std::clamp(det / (2.0 * p * p * p), -1.0, 1.0);
+		return float(std::sqrt(q + 2.0 * p * std::cos(std::acos(r) / 3.0)));
+	}
+	Affine::Affine(const std::shared_ptr<Object>& obj, vec3 x, vec3 y, vec3 z, vec3 offset)
+			: object(obj), x(x), y(y), z(z), offset(offset) {
+		if (!(std::abs(glm::dot(x, glm::cross(y, z))) > 1e-12f)) throw std::invalid_argument("singular affine transform");
+		inverse = glm::inverse(glm::transpose(glm::mat3{ x, y, z }));
+		// rotations stay exact instead of paying for rounding noise in their matrices
+		const float stretch = max_stretch(x, y, z);
+		scale = std::abs(stretch - 1.0f) < 1e-5f ? 1.0f : 1.0f / stretch;
+	}
+	
+	std::shared_ptr<Object> Affine::fuse(const std::shared_ptr<Object>& object) {
+		vec3 x{ 1.0f, 0.0f, 0.0f }, y{ 0.0f, 1.0f, 0.0f }, z{ 0.0f, 0.0f, 1.0f }, offset{};
+		// the inner transform n applies after the ones collected so far
+		const auto then = [&](vec3 nx, vec3 ny, vec3 nz, vec3 nt) {
+			const vec3 ax = x, ay = y, az = z;
+			x = nx.x * ax + nx.y * ay + nx.z * az;
+			y = ny.x * ax + ny.y * ay + ny.z * az;
+			z = nz.x * ax + nz.y * ay + nz.z * az;
+			offset = vec3{ glm::dot(nx, offset), glm::dot(ny, offset), glm::dot(nz, offset) } + nt;
+		};
+		auto node = object;
+		int levels = 0;
+		for (;; ++levels) {
+			if (const auto* t = dynamic_cast<const Translation*>(node.get())) {
+				then({ 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, -t->translation);
+				node = t->object;
+			}
+			else if (const auto* r = dynamic_cast<const RotationX*>(node.get())) {
+				const float s = std::sin(r->rotation), c = std::cos(r->rotation);
+				then({ 1.0f, 0.0f, 0.0f }, { 0.0f, c, -s }, { 0.0f, s, c }, {});
+				node = r->object;
+			}
+			else if (const auto* r = dynamic_cast<const RotationY*>(node.get())) {
+				const float s = std::sin(r->rotation), c = std::cos(r->rotation);
+				then({ c, 0.0f, -s }, { 0.0f, 1.0f, 0.0f }, { s, 0.0f, c }, {});
+				node = r->object;
+			}
+			else if (const auto* a = dynamic_cast<const Affine*>(node.get())) {
+				then(a->x, a->y, a->z, a->offset);
+				node = a->object;
+			}
+			else break;
+		}
+		// a single translation or rotation is cheaper than a full matrix
+		if (levels < 2) return object;
+		return std::make_shared<Affine>(node, x, y, z, offset);
+	}
+	
+	void Translation::update(vec3 t) {
+		const auto before = bounds();
+		translation = t;
+		touch(before);
+	}
 	void RotationX::update(float r) {
+		const auto before = bounds();
 		rotation = r;
 		sinr = std::sin(r);
 		cosr = std::cos(r);
+		touch(before);
 	}
 	void RotationY::update(float r) {
+		const auto before = bounds();
 		rotation = r;
 		sinr = std::sin(r);
 		cosr = std::cos(r);
+		touch(before);
 	}
 }
\ No newline at end of file
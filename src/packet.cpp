@@ -0,0 +1,86 @@
+#include <atomic>
+#include <vector>
+#include "raytracer.hpp"
+#include "packet.hpp"
+#include "profiler.hpp"
+
+namespace sdf {
+	[[nodiscard]]
+	static PacketIsa detect_packet_isa() noexcept {
+#if defined(SDF_PACKET_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return PacketIsa::AVX2;
+		return PacketIsa::SSE;
+#else
+		return PacketIsa::Scalar;
+#endif
+	}
+	static const PacketIsa supported_isa = detect_packet_isa();
+	static std::atomic<PacketIsa> current_isa = supported_isa;
+	
+	PacketIsa packet_isa() noexcept { return current_isa; }
+	PacketIsa set_packet_isa(PacketIsa isa) noexcept {
+		current_isa = std::min(isa, supported_isa);
+		return current_isa;
+	}
+	std::size_t packet_width(PacketIsa isa) noexcept {
+		switch (isa) {
+		case PacketIsa::AVX2: return 8;
+		case PacketIsa::SSE: return 4;
+		default: return 1;
+		}
+	}
+	
+	void trace_packet(const std::shared_ptr<CompiledObject>& object, const Ray* rays, std::size_t count, Color* out, float bgDist,
+			float* depth, std::uint32_t* material, PixelCost* cost, const float* starts) {
+		const auto& program = object->program;
+		const auto isa = packet_isa();
+		std::vector<float> ts(count), steps(count);
+		std::vector<std::uint8_t> hits(count);
+		{
+			ProfileScope scope{ Stage::March };
+			if (isa == PacketIsa::Scalar) {
+				for (std::size_t i = 0; i < count; ++i) {
+					const auto result = march(program, rays[i], bgDist, starts ? starts[i] : 0.0f);
+					ts[i] = result.t, steps[i] = float(result.steps), hits[i] = result.end != MarchEnd::Sky;
+				}
+			}
+#if defined(SDF_PACKET_X86)
+			else {
+				const auto march = isa == PacketIsa::AVX2 ? march_avx2 : march_sse;
+				const auto& settings = march_settings();
+				const std::size_t width = packet_width(isa);
+				for (std::size_t base = 0; base < count; base += width) {
+					RayPacket packet{};
+					packet.count = std::min(width, count - base);
+					for (std::size_t i = 0; i < packet.count; ++i) {
+						const auto& ray = rays[base + i];
+						packet.ox[i] = ray.origin.x, packet.oy[i] = ray.origin.y, packet.oz[i] = ray.origin.z;
+						packet.dx[i] = ray.direction.x, packet.dy[i] = ray.direction.y, packet.dz[i] = ray.direction.z;
+						packet.far[i] = std::min(bgDist, exit_distance(program.bounds, ray));
+						packet.start[i] = starts ? starts[base + i] : 0.0f;
+					}
+					march(program.code.data(), program.code.size(), packet, settings);
+					for (std::size_t i = 0; i < packet.count; ++i) {
+						ts[base + i] = packet.t[i], steps[base + i] = packet.steps[i], hits[base + i] = (packet.hit >> i) & 1;
+						thread_evaluations += std::uint64_t(packet.steps[i]);
+					}
+				}
+			}
+#endif
+		}
+		
+		ProfileScope scope{ Stage::Shade };
+		for (std::size_t i = 0; i < count; ++i) {
+			const std::uint64_t evaluations = thread_evaluations;
+			Ray ray = rays[i];
+			ray.origin += ray.direction * ts[i];
+			if (depth) depth[i] = hits[i] ? ts[i] : std::numeric_limits<float>::infinity();
+			thread_evaluations += hits[i];
+			const auto id = hits[i] ? program.evaluate(ray.origin).second : no_material;
+			if (material) material[i] = id;
+			out[i] = hits[i] ? program.materials[id]->shade(ray, object) : project_background(ray);
+			if (cost) cost[i] = { std::uint32_t(steps[i]), std::uint32_t(steps[i]) + std::uint32_t(thread_evaluations - evaluations) };
+		}
+	}
+}
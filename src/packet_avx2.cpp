@@ -0,0 +1,43 @@
+#if defined(__AVX2__)
+#include <immintrin.h>
+#include "packet_kernel.hpp"
+
+namespace sdf {
+	namespace {
+		struct Avx2 {
+			using reg = __m256;
+			static constexpr int all = 0xFF;
+			static reg set1(float f) noexcept { return _mm256_set1_ps(f); }
+			static reg load(const float* p) noexcept { return _mm256_loadu_ps(p); }
+			static void store(float* p, reg a) noexcept { _mm256_storeu_ps(p, a); }
+			static reg add(reg a, reg b) noexcept { return _mm256_add_ps(a, b); }
+			static reg sub(reg a, reg b) noexcept { return _mm256_sub_ps(a, b); }
+			static reg mul(reg a, reg b) noexcept { return _mm256_mul_ps(a, b); }
+			static reg min(reg a, reg b) noexcept { return _mm256_min_ps(a, b); }
+			static reg max(reg a, reg b) noexcept { return _mm256_max_ps(a, b); }
+			static reg sqrt(reg a) noexcept { return _mm256_sqrt_ps(a); }
+			static reg round(reg a) noexcept { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+			static reg neg(reg a) noexcept { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+			static reg abs(reg a) noexcept { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+			static reg gt(reg a, reg b) noexcept { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+			static reg ge(reg a, reg b) noexcept { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+			static reg bit_and(reg a, reg b) noexcept { return _mm256_and_ps(a, b); }
+			static reg bit_or(reg a, reg b) noexcept { return _mm256_or_ps(a, b); }
+			static reg bit_andnot(reg a, reg b) noexcept { return _mm256_andnot_ps(a, b); }
+			static reg blend(reg m, reg a, reg b) noexcept { return _mm256_blendv_ps(b, a, m); }
+			static int bits(reg m) noexcept { return _mm256_movemask_ps(m); }
+			static reg first(std::size_t n) noexcept {
+				const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+				return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(int(n)), lanes));
+			}
+		};
+	}
+	
+	void march_avx2(const Instruction* code, std::size_t size, RayPacket& packet, const MarchSettings& settings) noexcept {
+		packet_march<Avx2>(code, size, packet, settings);
+	}
+	void distance_avx2(const Instruction* code, std::size_t size, const float* x, const float* y, const float* z, float* out) noexcept {
+		packet_distance<Avx2>(code, size, x, y, z, out);
+	}
+}
+#endif
@@ -0,0 +1,206 @@
+#ifndef SDF_PACKET_KERNEL_HPP
+#define SDF_PACKET_KERNEL_HPP
+#include <tuple>
+#include "packet.hpp"
+
+// Generic packet interpreter, included by one translation unit per instruction set.
+// Everything lives in an anonymous namespace so that differently compiled copies never get merged.
+namespace sdf { namespace {
+	template<class V>
+	struct Lanes {
+		using reg = typename V::reg;
+		reg x, y, z;
+		
+		reg& operator[](int i) noexcept { return i == 0 ? x : i == 1 ? y : z; }
+	};
+	
+	template<class V>
+	inline typename V::reg cube_distance(const Lanes<V>& p, typename V::reg h) noexcept {
+		using reg = typename V::reg;
+		const reg zero = V::set1(0.0f);
+		const reg dx = V::sub(V::abs(p.x), h), dx0 = V::max(zero, dx);
+		const reg dy = V::sub(V::abs(p.y), h), dy0 = V::max(zero, dy);
+		const reg dz = V::sub(V::abs(p.z), h), dz0 = V::max(zero, dz);
+		
+		const reg inner = V::min(zero, V::max(dx, V::max(dy, dz)));
+		const reg outer = V::sqrt(V::add(V::mul(dx0, dx0), V::add(V::mul(dy0, dy0), V::mul(dz0, dz0))));
+		return V::add(inner, outer);
+	}
+	
+	template<class V>
+	inline typename V::reg packet_distance(const Instruction* code, std::size_t size, Lanes<V> p) noexcept {
+		using reg = typename V::reg;
+		Lanes<V> points[max_stack_depth];
+		reg values[max_stack_depth];
+		std::size_t sp = 0, vp = 0;
+		std::pair<const Instruction*, const Instruction*> pending[max_order_depth];
+		std::size_t pp = 0;
+		
+		for (const Instruction *ins = code, *end = code + size; ins != end || pp; ++ins) {
+			if (ins == end) {
+				std::tie(ins, end) = pending[--pp];
+				--ins;
+				continue;
+			}
+			switch (ins->op) {
+			case Opcode::Sphere: {
+				const reg len = V::sqrt(V::add(V::mul(p.x, p.x), V::add(V::mul(p.y, p.y), V::mul(p.z, p.z))));
+				values[vp++] = V::sub(len, V::set1(ins->args[0]));
+				break;
+			}
+			case Opcode::Cube:
+				values[vp++] = cube_distance<V>(p, V::set1(ins->args[0] / 2));
+				break;
+			case Opcode::Translate:
+				points[sp++] = p;
+				p.x = V::sub(p.x, V::set1(ins->args[0]));
+				p.y = V::sub(p.y, V::set1(ins->args[1]));
+				p.z = V::sub(p.z, V::set1(ins->args[2]));
+				break;
+			case Opcode::RotateX: {
+				const reg sinr = V::set1(ins->args[0]), cosr = V::set1(ins->args[1]);
+				points[sp++] = p;
+				const reg y = V::sub(V::mul(cosr, p.y), V::mul(sinr, p.z));
+				const reg z = V::add(V::mul(sinr, p.y), V::mul(cosr, p.z));
+				p.y = y, p.z = z;
+				break;
+			}
+			case Opcode::RotateY: {
+				const reg sinr = V::set1(ins->args[0]), cosr = V::set1(ins->args[1]);
+				points[sp++] = p;
+				const reg x = V::sub(V::mul(cosr, p.x), V::mul(sinr, p.z));
+				const reg z = V::add(V::mul(sinr, p.x), V::mul(cosr, p.z));
+				p.x = x, p.z = z;
+				break;
+			}
+			case Opcode::Pop:
+				p = points[--sp];
+				break;
+			case Opcode::Union:
+				--vp;
+				values[vp - 1] = V::min(values[vp - 1], values[vp]);
+				break;
+			case Opcode::Intersection:
+				--vp;
+				values[vp - 1] = V::max(values[vp - 1], values[vp]);
+				break;
+			case Opcode::Subtraction:
+				--vp;
+				values[vp - 1] = V::max(values[vp - 1], V::neg(values[vp]));
+				break;
+			case Opcode::Infinity:
+				values[vp++] = V::set1(__builtin_inff());
+				break;
+			case Opcode::Cull: {
+				const reg zero = V::set1(0.0f);
+				const reg qx = V::max(zero, V::max(V::sub(V::set1(ins->args[0]), p.x), V::sub(p.x, V::set1(ins->args[3]))));
+				const reg qy = V::max(zero, V::max(V::sub(V::set1(ins->args[1]), p.y), V::sub(p.y, V::set1(ins->args[4]))));
+				const reg qz = V::max(zero, V::max(V::sub(V::set1(ins->args[2]), p.z), V::sub(p.z, V::set1(ins->args[5]))));
+				const reg dist = V::sqrt(V::add(V::mul(qx, qx), V::add(V::mul(qy, qy), V::mul(qz, qz))));
+				if (V::bits(V::ge(dist, values[vp - 1])) == V::all)
+					ins += ins->material;
+				break;
+			}
+			// lanes that disagree keep the stored order
+			case Opcode::Order: {
+				const std::size_t first = ins->material, second = ins->length;
+				const reg coordinate = p[int(ins->args[0])];
+				if (pp + 2 <= max_order_depth && V::bits(V::ge(coordinate, V::set1(ins->args[1]))) == V::all) {
+					pending[pp++] = { ins + 1 + first + second, end };
+					pending[pp++] = { ins + 1, ins + 1 + first };
+					end = ins + 1 + first + second;
+					ins += first;
+				}
+				break;
+			}
+			case Opcode::Repeat:
+				points[sp++] = p;
+				for (int i = 0; i < 3; ++i) {
+					if (ins->args[i] == 0.0f) continue;
+					const float inv = 1.0f / ins->args[i];
+					const reg cell = V::min(V::max(V::round(V::mul(p[i], V::set1(inv))), V::set1(-ins->args[i + 3])), V::set1(ins->args[i + 3]));
+					p[i] = V::sub(p[i], V::mul(V::set1(ins->args[i]), cell));
+				}
+				break;
+			case Opcode::Mirror:
+				points[sp++] = p;
+				for (int i = 0; i < 3; ++i) {
+					if (ins->args[i] != 0.0f) p[i] = V::abs(p[i]);
+				}
+				break;
+			case Opcode::SmoothUnion:
+			case Opcode::SmoothIntersection:
+			case Opcode::SmoothSubtraction: {
+				--vp;
+				const reg a = values[vp - 1], b = ins->op == Opcode::SmoothSubtraction ? V::neg(values[vp]) : values[vp];
+				const reg h = V::mul(V::max(V::sub(V::set1(ins->args[0]), V::abs(V::sub(a, b))), V::set1(0.0f)), V::set1(1.0f / ins->args[0]));
+				const reg bulge = V::mul(V::mul(h, h), V::set1(ins->args[0] * 0.25f));
+				values[vp - 1] = ins->op == Opcode::SmoothUnion ? V::sub(V::min(a, b), bulge) : V::add(V::max(a, b), bulge);
+				break;
+			}
+			case Opcode::Affine: {
+				const Instruction* operand = ++ins;
+				points[sp++] = p;
+				const auto row = [&](float x, float y, float z, float offset) {
+					return V::add(V::add(V::mul(V::set1(x), p.x), V::add(V::mul(V::set1(y), p.y), V::mul(V::set1(z), p.z))), V::set1(offset));
+				};
+				p = { row(ins[-1].args[0], ins[-1].args[1], ins[-1].args[2], operand->args[3]),
+					row(ins[-1].args[3], ins[-1].args[4], ins[-1].args[5], operand->args[4]),
+					row(operand->args[0], operand->args[1], operand->args[2], operand->args[5]) };
+				break;
+			}
+			case Opcode::Operand:
+				break;
+			case Opcode::Scale:
+				values[vp - 1] = V::mul(values[vp - 1], V::set1(ins->args[0]));
+				break;
+			}
+		}
+		return values[0];
+	}
+	
+	template<class V>
+	inline void packet_distance(const Instruction* code, std::size_t size, const float* x, const float* y, const float* z, float* out) noexcept {
+		V::store(out, packet_distance<V>(code, size, { V::load(x), V::load(y), V::load(z) }));
+	}
+	
+	// Lane-wise copy of march() from march.hpp, lanes that run out of steps count as hits.
+	template<class V>
+	inline void packet_march(const Instruction* code, std::size_t size, RayPacket& packet, const MarchSettings& settings) noexcept {
+		using reg = typename V::reg;
+		const reg zero = V::set1(0.0f), one = V::set1(1.0f);
+		const reg eps = V::set1(settings.epsilon), cone = V::set1(settings.pixel_cone), far = V::load(packet.far);
+		const reg ox = V::load(packet.ox), oy = V::load(packet.oy), oz = V::load(packet.oz);
+		const reg dx = V::load(packet.dx), dy = V::load(packet.dy), dz = V::load(packet.dz);
+		
+		reg t = V::load(packet.start), omega = V::set1(settings.relaxation), previous = zero, step = zero, steps = zero;
+		reg sky = V::bit_and(V::first(packet.count), V::ge(t, far));
+		reg active = V::bit_andnot(sky, V::first(packet.count));
+		for (int i = 0; i < settings.max_steps && V::bits(active); ++i) {
+			const Lanes<V> p{ V::add(ox, V::mul(dx, t)), V::add(oy, V::mul(dy, t)), V::add(oz, V::mul(dz, t)) };
+			const reg d = packet_distance<V>(code, size, p);
+			const reg radius = V::abs(d);
+			steps = V::add(steps, V::bit_and(active, one));
+			
+			const reg failed = V::bit_and(active, V::bit_and(V::gt(omega, one), V::gt(step, V::add(radius, previous))));
+			t = V::blend(failed, V::sub(t, V::sub(step, previous)), t);
+			omega = V::blend(failed, one, omega);
+			const reg checked = V::bit_andnot(failed, active);
+			
+			const reg hit = V::bit_and(checked, V::ge(V::add(eps, V::mul(cone, t)), radius));
+			const reg positive = V::gt(d, zero);
+			const reg escaped = V::bit_and(V::bit_andnot(hit, checked), V::bit_and(positive, V::ge(V::add(t, d), far)));
+			const reg moving = V::bit_andnot(V::bit_or(hit, escaped), checked);
+			step = V::blend(moving, V::blend(positive, V::mul(d, omega), d), step);
+			previous = V::blend(moving, radius, previous);
+			t = V::blend(moving, V::add(t, step), t);
+			sky = V::bit_or(sky, escaped);
+			active = V::bit_andnot(V::bit_or(hit, escaped), active);
+		}
+		V::store(packet.t, t);
+		V::store(packet.steps, steps);
+		packet.hit = std::uint32_t(V::bits(V::bit_andnot(sky, V::first(packet.count))));
+	}
+} }
+
+#endif /* SDF_PACKET_KERNEL_HPP */
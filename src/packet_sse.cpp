@@ -0,0 +1,43 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include "packet_kernel.hpp"
+
+namespace sdf {
+	namespace {
+		struct Sse {
+			using reg = __m128;
+			static constexpr int all = 0xF;
+			static reg set1(float f) noexcept { return _mm_set1_ps(f); }
+			static reg load(const float* p) noexcept { return _mm_loadu_ps(p); }
+			static void store(float* p, reg a) noexcept { _mm_storeu_ps(p, a); }
+			static reg add(reg a, reg b) noexcept { return _mm_add_ps(a, b); }
+			static reg sub(reg a, reg b) noexcept { return _mm_sub_ps(a, b); }
+			static reg mul(reg a, reg b) noexcept { return _mm_mul_ps(a, b); }
+			static reg min(reg a, reg b) noexcept { return _mm_min_ps(a, b); }
+			static reg max(reg a, reg b) noexcept { return _mm_max_ps(a, b); }
+			static reg sqrt(reg a) noexcept { return _mm_sqrt_ps(a); }
+			static reg round(reg a) noexcept { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+			static reg neg(reg a) noexcept { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+			static reg abs(reg a) noexcept { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+			static reg gt(reg a, reg b) noexcept { return _mm_cmpgt_ps(a, b); }
+			static reg ge(reg a, reg b) noexcept { return _mm_cmpge_ps(a, b); }
+			static reg bit_and(reg a, reg b) noexcept { return _mm_and_ps(a, b); }
+			static reg bit_or(reg a, reg b) noexcept { return _mm_or_ps(a, b); }
+			static reg bit_andnot(reg a, reg b) noexcept { return _mm_andnot_ps(a, b); }
+			static reg blend(reg m, reg a, reg b) noexcept { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+			static int bits(reg m) noexcept { return _mm_movemask_ps(m); }
+			static reg first(std::size_t n) noexcept {
+				const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+				return _mm_castsi128_ps(_mm_cmplt_epi32(lanes, _mm_set1_epi32(int(n))));
+			}
+		};
+	}
+	
+	void march_sse(const Instruction* code, std::size_t size, RayPacket& packet, const MarchSettings& settings) noexcept {
+		packet_march<Sse>(code, size, packet, settings);
+	}
+	void distance_sse(const Instruction* code, std::size_t size, const float* x, const float* y, const float* z, float* out) noexcept {
+		packet_distance<Sse>(code, size, x, y, z, out);
+	}
+}
+#endif
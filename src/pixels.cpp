@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include "pixels.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sdf {
+	static constexpr std::array<std::array<float, 4>, 4> bayer = [] {
+		constexpr int m[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+		std::array<std::array<float, 4>, 4> t{};
+		for (int y = 0; y < 4; ++y)
+			for (int x = 0; x < 4; ++x)
+				t[y][x] = (float(m[y][x]) + 0.5f) / 16.0f;
+		return t;
+	}();
+	
+	// sRGB encoded values of linear intensities i / srgb_steps, interpolated in between
+	static constexpr int srgb_steps = 1024;
+	static const std::array<float, srgb_steps + 2> srgb_table = [] {
+		std::array<float, srgb_steps + 2> t{};
+		for (int i = 0; i <= srgb_steps; ++i) {
+			const double c = double(i) / srgb_steps;
+			t[i] = float(c <= 0.0031308 ? 12.92 * c : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055);
+		}
+		t[srgb_steps + 1] = t[srgb_steps];
+		return t;
+	}();
+	// Clamps to [0, 1], NaN becomes 0 since std::clamp would pass it on.
+	[[nodiscard]]
+	static float saturate(float c) noexcept { return c > 0.0f ? std::min(c, 1.0f) : 0.0f; }
+	[[nodiscard]]
+	static float encode_srgb(float c) noexcept {
+		const float f = saturate(c) * float(srgb_steps);
+		const int i = int(f);
+		return srgb_table[i] + (srgb_table[i + 1] - srgb_table[i]) * (f - float(i));
+	}
+	
+	// Writes the bytes of every pixel in channel order r, g, b, a, or b, g, r, a if `swap` is set.
+	static void encode(const Color* in, std::uint8_t* out, std::size_t count, int x, int y, PixelEncoding encoding, bool swap) noexcept {
+		const auto& row = bayer[std::size_t(y) & 3];
+		const auto color = [&](std::size_t i) {
+			Color c = in[i];
+			if (encoding.srgb) c = { encode_srgb(c.x), encode_srgb(c.y), encode_srgb(c.z), c.w };
+			return swap ? Color{ c.z, c.y, c.x, c.w } : c;
+		};
+		const auto threshold = [&](std::size_t i) { return encoding.dither ? row[std::size_t(x + int(i)) & 3] : 0.5f; };
+		std::size_t i = 0;
+#if defined(__SSE2__)
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f);
+		const auto quantize = [&](std::size_t j) {
+			__m128 v = encoding.srgb ? _mm_setr_ps(encode_srgb(in[j].x), encode_srgb(in[j].y), encode_srgb(in[j].z), in[j].w) : _mm_loadu_ps(&in[j].x);
+			if (swap) v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+			// max takes its second operand for NaN lanes
+			v = _mm_min_ps(_mm_max_ps(v, zero), one);
+			return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), _mm_set1_ps(threshold(j))));
+		};
+		for (; i + 4 <= count; i += 4) {
+			const __m128i lo = _mm_packs_epi32(quantize(i), quantize(i + 1));
+			const __m128i hi = _mm_packs_epi32(quantize(i + 2), quantize(i + 3));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_packus_epi16(lo, hi));
+		}
+#endif
+		for (; i < count; ++i) {
+			const Color c = color(i);
+			for (int k = 0; k < 4; ++k)
+				out[i * 4 + k] = std::uint8_t(saturate(c[k]) * 255.0f + threshold(i));
+		}
+	}
+	
+	void encode_rgba(const Color* in, std::uint8_t* out, std::size_t count, int x, int y, PixelEncoding encoding) noexcept {
+		encode(in, out, count, x, y, encoding, false);
+	}
+	void encode_argb(const Color* in, std::uint32_t* out, std::size_t count, int x, int y, PixelEncoding encoding) noexcept {
+		// 0xAARRGGBB is stored as b, g, r, a on little endian machines
+		if constexpr (std::endian::native == std::endian::little) {
+			encode(in, reinterpret_cast<std::uint8_t*>(out), count, x, y, encoding, true);
+		}
+		else {
+			encode(in, reinterpret_cast<std::uint8_t*>(out), count, x, y, encoding, false);
+			for (std::size_t i = 0; i < count; ++i)
+				out[i] = out[i] >> 8 | out[i] << 24;
+		}
+	}
+}
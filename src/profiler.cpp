@@ -0,0 +1,125 @@
+#include <spdlog/spdlog.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "profiler.hpp"
+
+namespace sdf {
+	namespace {
+		struct Event {
+			Stage stage;
+			std::uint64_t frame;
+			std::int64_t begin, end;
+			std::uint64_t evaluations;
+		};
+		struct Recorder {
+			std::size_t thread;
+			std::vector<Event> events;
+		};
+		
+		std::atomic_bool enabled = false;
+		std::atomic_uint64_t current_frame = 0;
+		// recorders outlive their threads so that their events can still be written
+		std::mutex recorders_mutex;
+		std::vector<std::shared_ptr<Recorder>> recorders;
+		const auto epoch = std::chrono::steady_clock::now();
+		std::atomic_uint64_t flushed_evaluations = 0;
+		thread_local std::uint64_t thread_flushed = 0;
+		
+		Recorder& recorder() {
+			thread_local const std::shared_ptr<Recorder> local = [] {
+				const std::lock_guard lock{ recorders_mutex };
+				auto r = std::make_shared<Recorder>(Recorder{ recorders.size(), {} });
+				recorders.push_back(r);
+				return r;
+			}();
+			return *local;
+		}
+	}
+	
+	const char* stage_name(Stage stage) noexcept {
+		switch (stage) {
+		case Stage::Frame: return "frame";
+		case Stage::RayGen: return "ray gen";
+		case Stage::March: return "march";
+		case Stage::Shade: return "shade";
+		case Stage::Blit: return "blit";
+		case Stage::Present: return "present";
+		}
+		return "?";
+	}
+	
+	void flush_evaluations() noexcept {
+		flushed_evaluations.fetch_add(thread_evaluations - thread_flushed, std::memory_order_relaxed);
+		thread_flushed = thread_evaluations;
+	}
+	std::uint64_t total_evaluations() noexcept {
+		flush_evaluations();
+		return flushed_evaluations.load(std::memory_order_relaxed);
+	}
+	
+	void set_profiling(bool e) noexcept { enabled.store(e, std::memory_order_relaxed); }
+	bool profiling() noexcept { return enabled.load(std::memory_order_relaxed); }
+	void profile_frame(std::uint64_t frame) noexcept { current_frame.store(frame, std::memory_order_relaxed); }
+	void reset_profile() noexcept {
+		const std::lock_guard lock{ recorders_mutex };
+		for (const auto& r : recorders)
+			r->events.clear();
+	}
+	
+	std::int64_t profile_clock() noexcept {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+	void record_stage(Stage stage, std::int64_t begin, std::uint64_t evaluations) {
+		recorder().events.push_back({ stage, current_frame.load(std::memory_order_relaxed), begin, profile_clock(), evaluations });
+	}
+	
+	std::array<StageTotals, stage_count> profile_totals() {
+		std::array<StageTotals, stage_count> totals{};
+		const std::lock_guard lock{ recorders_mutex };
+		for (const auto& r : recorders) {
+			for (const auto& e : r->events) {
+				auto& total = totals[std::size_t(e.stage)];
+				total.seconds += double(e.end - e.begin) * 1e-9;
+				total.evaluations += e.evaluations;
+				++total.count;
+			}
+		}
+		return totals;
+	}
+	
+	void log_profile() {
+		const auto totals = profile_totals();
+		for (std::size_t s = 0; s < stage_count; ++s) {
+			if (!totals[s].count) continue;
+			spdlog::info("{}: {:.3f} ms in {} events, {} evaluations", stage_name(Stage(s)),
+				totals[s].seconds * 1000.0, totals[s].count, totals[s].evaluations);
+		}
+	}
+	
+	bool write_chrome_trace(const std::string& path) {
+		std::ofstream out{ path, std::ios::binary };
+		if (!out) return false;
+		out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		const std::lock_guard lock{ recorders_mutex };
+		for (const auto& r : recorders) {
+			if (r->events.empty()) continue;
+			out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << r->thread
+				<< ",\"args\":{\"name\":\"thread " << r->thread << "\"}}";
+			first = false;
+			// timestamps are in microseconds
+			for (const auto& e : r->events) {
+				out << ",\n{\"name\":\"" << stage_name(e.stage) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << r->thread
+					<< ",\"ts\":" << double(e.begin) * 1e-3 << ",\"dur\":" << double(e.end - e.begin) * 1e-3
+					<< ",\"args\":{\"frame\":" << e.frame << ",\"evaluations\":" << e.evaluations << "}}";
+			}
+		}
+		out << "\n]}\n";
+		return bool(out);
+	}
+}
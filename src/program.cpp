@@ -0,0 +1,286 @@
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+#include "program.hpp"
+#include "primitives.hpp"
+#include "lighting.hpp"
+#include "march.hpp"
+#include "profiler.hpp"
+
+namespace sdf {
+	Program Program::compile(const Object& object) {
+		Program program{};
+		object.compile(program);
+		program.bounds = object.bounds();
+		program.validate();
+		return program;
+	}
+	void Program::validate() const {
+		std::size_t points = 0, values = 0, maxPoints = 0, maxValues = 0;
+		for (const auto& ins : code) {
+			switch (ins.op) {
+			case Opcode::Sphere:
+			case Opcode::Cube:
+			case Opcode::Infinity: ++values; break;
+			case Opcode::Cull:
+			case Opcode::Order: break;
+			case Opcode::Translate:
+			case Opcode::RotateX:
+			case Opcode::RotateY:
+			case Opcode::Repeat:
+			case Opcode::Mirror:
+			case Opcode::Affine: ++points; break;
+			case Opcode::Pop: --points; break;
+			case Opcode::Union:
+			case Opcode::Intersection:
+			case Opcode::Subtraction:
+			case Opcode::SmoothUnion:
+			case Opcode::SmoothIntersection:
+			case Opcode::SmoothSubtraction: --values; break;
+			case Opcode::Operand:
+			case Opcode::Scale: break;
+			}
+			maxPoints = std::max(maxPoints, points);
+			maxValues = std::max(maxValues, values);
+		}
+		if (values != 1 || points != 0)
+			throw std::logic_error("unbalanced sdf program");
+		if (maxPoints > max_stack_depth || maxValues > max_stack_depth)
+			throw std::length_error("sdf program exceeds the maximum stack depth");
+	}
+	
+	void Program::emit(Opcode op, float a, float b, float c, std::uint32_t material) {
+		code.push_back({ op, material, { a, b, c } });
+	}
+	std::uint32_t Program::material(const std::shared_ptr<Shader>& shader) {
+		const auto it = std::find(materials.begin(), materials.end(), shader);
+		if (it != materials.end())
+			return std::uint32_t(it - materials.begin());
+		materials.push_back(shader);
+		return std::uint32_t(materials.size() - 1);
+	}
+	
+	// Rows map world space directions into the local space of the current transform.
+	struct Frame {
+		vec3 x, y, z;
+		
+		[[nodiscard]]
+		vec3 to_world(vec3 g) const noexcept { return x * g.x + y * g.y + z * g.z; }
+	};
+	
+	template<bool Material, bool Gradient>
+	static Program::Sample run(const std::vector<Instruction>& code, vec3 p) noexcept {
+		constexpr std::size_t gradients = Gradient ? max_stack_depth : 1;
+		vec3 points[max_stack_depth];
+		float values[max_stack_depth];
+		std::uint32_t materials[Material ? max_stack_depth : 1];
+		Frame frames[gradients];
+		vec3 grads[gradients];
+		Frame frame{ { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+		std::size_t sp = 0, vp = 0;
+		// ranges of code still to run after the current one, pushed by Order
+		std::pair<std::size_t, std::size_t> pending[max_order_depth];
+		std::size_t pp = 0;
+		
+		// moves the distance on top of the stack one slot down, negated for subtractions
+		const auto replace = [&](float sign) {
+			values[vp - 1] = sign * values[vp];
+			if constexpr (Material) materials[vp - 1] = materials[vp];
+			if constexpr (Gradient) grads[vp - 1] = sign * grads[vp];
+		};
+		const auto push = [&] {
+			points[sp] = p;
+			if constexpr (Gradient) frames[sp] = frame;
+			++sp;
+		};
+		// blends the topmost distance into the one below, `winner` tells whether the top one decides the material
+		const auto blend = [&](float value, bool winner, float h, float sign) {
+			if constexpr (Gradient) {
+				const vec3 top = sign * grads[vp], below = grads[vp - 1];
+				grads[vp - 1] = winner ? (1.0f - 0.5f * h) * top + 0.5f * h * below : (1.0f - 0.5f * h) * below + 0.5f * h * top;
+			}
+			if constexpr (Material) if (winner) materials[vp - 1] = materials[vp];
+			values[vp - 1] = value;
+		};
+		
+		for (std::size_t ip = 0, end = code.size(); ip != end || pp; ) {
+			if (ip == end) {
+				std::tie(ip, end) = pending[--pp];
+				continue;
+			}
+			const auto& ins = code[ip++];
+			switch (ins.op) {
+			case Opcode::Sphere:
+				if constexpr (Material) materials[vp] = ins.material;
+				if constexpr (Gradient) grads[vp] = frame.to_world(sphere_gradient(p));
+				values[vp++] = sphere_distance(p, ins.args[0]);
+				break;
+			case Opcode::Cube:
+				if constexpr (Material) materials[vp] = ins.material;
+				if constexpr (Gradient) grads[vp] = frame.to_world(cube_gradient(p, ins.args[0]));
+				values[vp++] = cube_distance(p, ins.args[0]);
+				break;
+			case Opcode::Translate:
+				push();
+				p -= vec3{ ins.args[0], ins.args[1], ins.args[2] };
+				break;
+			case Opcode::RotateX: {
+				const float sinr = ins.args[0], cosr = ins.args[1];
+				push();
+				p = vec3{ p.x, cosr * p.y - sinr * p.z, sinr * p.y + cosr * p.z };
+				if constexpr (Gradient) frame = { frame.x, cosr * frame.y - sinr * frame.z, sinr * frame.y + cosr * frame.z };
+				break;
+			}
+			case Opcode::RotateY: {
+				const float sinr = ins.args[0], cosr = ins.args[1];
+				push();
+				p = vec3{ cosr * p.x - sinr * p.z, p.y, sinr * p.x + cosr * p.z };
+				if constexpr (Gradient) frame = { cosr * frame.x - sinr * frame.z, frame.y, sinr * frame.x + cosr * frame.z };
+				break;
+			}
+			case Opcode::Pop:
+				p = points[--sp];
+				if constexpr (Gradient) frame = frames[sp];
+				break;
+			case Opcode::Union:
+				--vp;
+				if (!(values[vp - 1] < values[vp])) replace(1.0f);
+				break;
+			case Opcode::Intersection:
+				--vp;
+				if (!(values[vp - 1] > values[vp])) replace(1.0f);
+				break;
+			case Opcode::Subtraction:
+				--vp;
+				if (!(values[vp - 1] > -values[vp])) replace(-1.0f);
+				break;
+			case Opcode::Infinity:
+				if constexpr (Material) materials[vp] = 0;
+				if constexpr (Gradient) grads[vp] = {};
+				values[vp++] = std::numeric_limits<float>::infinity();
+				break;
+			case Opcode::Cull: {
+				const Bounds box{ { ins.args[0], ins.args[1], ins.args[2] }, { ins.args[3], ins.args[4], ins.args[5] } };
+				if (box.distance(p) >= values[vp - 1])
+					ip += ins.material;
+				break;
+			}
+			case Opcode::Order: {
+				const std::size_t first = ins.material, second = ins.length;
+				if (pp + 2 <= max_order_depth && p[int(ins.args[0])] >= ins.args[1]) {
+					pending[pp++] = { ip + first + second, end };
+					pending[pp++] = { ip, ip + first };
+					ip += first;
+					end = ip + second;
+				}
+				break;
+			}
+			case Opcode::Repeat:
+				push();
+				p = repeat_point(p, { ins.args[0], ins.args[1], ins.args[2] }, { ins.args[3], ins.args[4], ins.args[5] });
+				break;
+			case Opcode::Mirror:
+				push();
+				for (int i = 0; i < 3; ++i) {
+					if (ins.args[i] == 0.0f || !(p[i] < 0.0f)) continue;
+					p[i] = -p[i];
+					if constexpr (Gradient) (i == 0 ? frame.x : i == 1 ? frame.y : frame.z) *= -1.0f;
+				}
+				break;
+			case Opcode::SmoothUnion: {
+				--vp;
+				const float a = values[vp - 1], b = values[vp], h = smooth_blend(a, b, ins.args[0]);
+				blend(std::min(a, b) - h * h * (ins.args[0] * 0.25f), !(a < b), h, 1.0f);
+				break;
+			}
+			case Opcode::SmoothIntersection: {
+				--vp;
+				const float a = values[vp - 1], b = values[vp], h = smooth_blend(a, b, ins.args[0]);
+				blend(std::max(a, b) + h * h * (ins.args[0] * 0.25f), !(a > b), h, 1.0f);
+				break;
+			}
+			case Opcode::SmoothSubtraction: {
+				--vp;
+				const float a = values[vp - 1], b = -values[vp], h = smooth_blend(a, b, ins.args[0]);
+				blend(std::max(a, b) + h * h * (ins.args[0] * 0.25f), !(a > b), h, -1.0f);
+				break;
+			}
+			case Opcode::Affine: {
+				const auto& operand = code[ip++];
+				const vec3 x{ ins.args[0], ins.args[1], ins.args[2] }, y{ ins.args[3], ins.args[4], ins.args[5] };
+				const vec3 z{ operand.args[0], operand.args[1], operand.args[2] };
+				push();
+				p = vec3{ glm::dot(x, p), glm::dot(y, p), glm::dot(z, p) } + vec3{ operand.args[3], operand.args[4], operand.args[5] };
+				if constexpr (Gradient) frame = { x.x * frame.x + x.y * frame.y + x.z * frame.z,
+					y.x * frame.x + y.y * frame.y + y.z * frame.z, z.x * frame.x + z.y * frame.y + z.z * frame.z };
+				break;
+			}
+			case Opcode::Operand:
+				break;
+			case Opcode::Scale:
+				values[vp - 1] *= ins.args[0];
+				if constexpr (Gradient) grads[vp - 1] *= ins.args[0];
+				break;
+			}
+		}
+		Program::Sample sample{ values[0] };
+		if constexpr (Material) sample.material = materials[0];
+		if constexpr (Gradient) sample.gradient = grads[0];
+		return sample;
+	}
+	
+	float Program::distance(vec3 p) const noexcept {
+		return run<false, false>(code, p).distance;
+	}
+	std::pair<float, std::uint32_t> Program::evaluate(vec3 p) const noexcept {
+		const auto s = run<true, false>(code, p);
+		return { s.distance, s.material };
+	}
+	vec3 Program::gradient(vec3 p) const noexcept {
+		return run<false, true>(code, p).gradient;
+	}
+	Program::Sample Program::sample(vec3 p) const noexcept {
+		return run<true, true>(code, p);
+	}
+	
+	
+	std::pair<float, std::shared_ptr<Shader>> CompiledObject::operator()(const vec3& p) const {
+		const auto [d, material] = program.evaluate(p);
+		return { d, program.materials[material] };
+	}
+	void CompiledObject::compile(Program& prog) const {
+		for (auto ins : program.code) {
+			if (ins.op == Opcode::Sphere || ins.op == Opcode::Cube)
+				ins.material = prog.material(program.materials[ins.material]);
+			prog.code.push_back(ins);
+		}
+	}
+	vec3 CompiledObject::normal(vec3 p) const noexcept {
+		++thread_evaluations;
+		return glm::normalize(program.gradient(p));
+	}
+	vec3 CompiledObject::gradient(vec3 p) const noexcept {
+		++thread_evaluations;
+		return program.gradient(p);
+	}
+	float CompiledObject::shadow(vec3 p, vec3 n, vec3 light) const noexcept {
+		const auto& settings = lighting_settings();
+		if (!settings.shadows) return 1.0f;
+		const Ray ray{ p + n * settings.bias, light };
+		if (shadow_cache_lookup(serial, ray)) return 1.0f;
+		const float far = std::min(settings.shadow_distance, exit_distance(program.bounds, ray));
+		const auto result = soft_shadow([this](vec3 q) { return program.distance(q); }, ray, far, settings);
+		if (result.slack > 0.0f) shadow_cache_store(serial, ray, result.slack);
+		return result.visibility;
+	}
+	float CompiledObject::occlusion(vec3 p, vec3 n) const noexcept {
+		const auto& settings = lighting_settings();
+		if (!settings.occlusion) return 1.0f;
+		return ambient_occlusion([this](vec3 q) { return program.distance(q); }, p, n, settings);
+	}
+	std::uint64_t CompiledObject::next_serial() noexcept {
+		static std::atomic_uint64_t serials{ 0 };
+		return ++serials;
+	}
+}
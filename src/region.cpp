@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include "region.hpp"
+#include "raytracer.hpp"
+#include "profiler.hpp"
+
+namespace sdf {
+	Accumulation::Accumulation(int width, int height)
+		: w(width), h(height), sums(std::size_t(width) * height), counts(std::size_t(width) * height) {}
+	
+	void Accumulation::reset(int x0, int y0, int x1, int y1) noexcept {
+		if (pass == 0) return;
+		for (int y = std::max(0, y0); y < std::min(h, y1); ++y) {
+			for (int x = std::max(0, x0); x < std::min(w, x1); ++x) {
+				sums[std::size_t(y) * w + x] = Color{ 0.0f };
+				counts[std::size_t(y) * w + x] = 0;
+			}
+		}
+	}
+	Color Accumulation::add(int x, int y, Color sum, std::uint32_t count) noexcept {
+		const std::size_t i = std::size_t(y) * w + x;
+		// the first pass overwrites, which makes reset free
+		if (pass == 0) {
+			sums[i] = sum;
+			counts[i] = count;
+		}
+		else {
+			sums[i] += sum;
+			counts[i] += count;
+		}
+		return sums[i] / float(counts[i]);
+	}
+	
+	FrameHistory::FrameHistory(int width, int height)
+		: w(width), h(height), colors(std::size_t(width) * height), valid(std::size_t(width) * height) {}
+	
+	void FrameHistory::store(int x, int y, Color color) noexcept {
+		const std::size_t i = std::size_t(y) * w + x;
+		colors[i] = color;
+		valid[i] = 1;
+	}
+	void FrameHistory::reset() noexcept { std::fill(valid.begin(), valid.end(), std::uint8_t(0)); }
+	void FrameHistory::reset(int x0, int y0, int x1, int y1) noexcept {
+		for (int y = std::max(0, y0); y < std::min(h, y1); ++y)
+			for (int x = std::max(0, x0); x < std::min(w, x1); ++x)
+				valid[std::size_t(y) * w + x] = 0;
+	}
+	
+	// Sample 0 is the pixel center, the others follow an R2 sequence shifted by a per pixel hash.
+	[[nodiscard]]
+	static vec2 sample_offset(int x, int y, std::uint32_t index) noexcept {
+		if (index == 0) return vec2{ 0.5f };
+		std::uint32_t seed = std::uint32_t(x) * 0x8DA6B343u ^ std::uint32_t(y) * 0xD8163841u;
+		seed = (seed ^ (seed >> 16)) * 0x7FEB352Du;
+		seed = (seed ^ (seed >> 15)) * 0x846CA68Bu;
+		seed ^= seed >> 16;
+		const vec2 shift{ float(seed & 0xFFFFu) / 65536.0f, float(seed >> 16) / 65536.0f };
+		const vec2 offset = shift + float(index) * vec2{ 0.7548776662f, 0.5698402910f };
+		return offset - glm::floor(offset);
+	}
+	
+	// Fills every pixel skipped by a checkerboard pass with its color from the history, or the average of its horizontal
+	// neighbours where the history does not know it.
+	static void reconstruct(Color* colors, int xoff, int yoff, int xsize, int ysize, int parity, const FrameHistory* history) noexcept {
+		for (int y = 0; y < ysize; ++y) {
+			Color* row = colors + std::size_t(y) * xsize;
+			for (int x = ((xoff + yoff + y + parity + 1) & 1); x < xsize; x += 2) {
+				if (history && history->known(xoff + x, yoff + y)) row[x] = history->color(xoff + x, yoff + y);
+				else if (xsize == 1) continue;
+				else if (x == 0) row[x] = row[std::min(1, xsize - 1)];
+				else if (x + 1 == xsize) row[x] = row[x - 1];
+				else row[x] = 0.5f * (row[x - 1] + row[x + 1]);
+			}
+		}
+	}
+	
+	// Neighbours outside of the region are unknown, so edges lying exactly on a region border go unnoticed.
+	static std::vector<bool> find_edges(const Color* colors, const float* depth, const std::uint32_t* material,
+			int xsize, int ysize, const RenderOptions& options) {
+		std::vector<bool> edges(std::size_t(xsize) * ysize);
+		const auto differ = [&](std::size_t a, std::size_t b) {
+			if (material[a] != material[b]) return true;
+			const float near = std::min(depth[a], depth[b]);
+			if (std::isfinite(near) && std::abs(depth[a] - depth[b]) > options.edge_depth * near) return true;
+			const vec3 contrast = glm::abs(vec3{ colors[a] } - vec3{ colors[b] });
+			return std::max({ contrast.x, contrast.y, contrast.z }) > options.edge_contrast;
+		};
+		for (int y = 0; y < ysize; ++y) {
+			for (int x = 0; x < xsize; ++x) {
+				const std::size_t i = std::size_t(y) * xsize + x;
+				if (x + 1 < xsize && differ(i, i + 1)) edges[i] = edges[i + 1] = true;
+				if (y + 1 < ysize && differ(i, i + xsize)) edges[i] = edges[i + xsize] = true;
+			}
+		}
+		return edges;
+	}
+	
+	Color heat_color(float cost) noexcept {
+		const float t = std::clamp(cost, 0.0f, 1.0f) * 3.0f;
+		if (t < 1.0f) return { 0.0f, t, 1.0f - t, 1.0f };
+		if (t < 2.0f) return { t - 1.0f, 1.0f, 0.0f, 1.0f };
+		return { 1.0f, 3.0f - t, 0.0f, 1.0f };
+	}
+	
+	void render_region(const std::shared_ptr<CompiledObject>& object, const PerspectiveCamera& camera, int width, int height,
+			int xoff, int yoff, int xsize, int ysize, Color* out, const RenderOptions& options) {
+		const std::size_t size = std::size_t(xsize) * ysize;
+		const auto pixel = [&](int x0, int y0, std::uint32_t index) {
+			const vec2 offset = sample_offset(xoff + x0, yoff + y0, index);
+			return camera.project((float(xoff + x0) + offset.x) / float(width), (float(yoff + y0) + offset.y) / float(height));
+		};
+		if (options.heatmap > 0.0f) {
+			std::vector<PixelCost> costs(size);
+			trace_region(object, camera, width, height, xoff, yoff, xsize, ysize, out, options.temporal, options.checkerboard, options.bgDist,
+				nullptr, nullptr, costs.data());
+			for (int y0 = 0; y0 < ysize; ++y0) {
+				for (int x0 = 0; x0 < xsize; ++x0) {
+					if (options.checkerboard >= 0 && ((xoff + x0 + yoff + y0) & 1) != options.checkerboard) continue;
+					const std::size_t i = std::size_t(y0) * xsize + x0;
+					out[i] = heat_color(float(costs[i].evaluations) / options.heatmap);
+				}
+			}
+			if (options.checkerboard >= 0)
+				reconstruct(out, xoff, yoff, xsize, ysize, options.checkerboard, nullptr);
+			return;
+		}
+		
+		Accumulation* accumulation = options.checkerboard < 0 ? options.accumulation : nullptr;
+		std::vector<Ray> rays{};
+		std::vector<Color> samples{};
+		
+		if (accumulation && accumulation->samples(xoff, yoff) > 0) {
+			rays.resize(size);
+			samples.resize(size);
+			for (int y0 = 0; y0 < ysize; ++y0)
+				for (int x0 = 0; x0 < xsize; ++x0)
+					rays[std::size_t(y0) * xsize + x0] = pixel(x0, y0, accumulation->samples(xoff + x0, yoff + y0));
+			trace_packet(object, rays.data(), size, samples.data(), options.bgDist);
+			for (std::size_t i = 0; i < size; ++i) {
+				out[i] = accumulation->add(xoff + int(i % xsize), yoff + int(i / xsize), samples[i], 1);
+				if (options.history) options.history->store(xoff + int(i % xsize), yoff + int(i / xsize), out[i]);
+			}
+			return;
+		}
+		
+		const bool antialias = options.checkerboard < 0 && options.edge_samples > 0;
+		std::vector<float> depth(antialias ? size : 0);
+		std::vector<std::uint32_t> material(antialias ? size : 0);
+		trace_region(object, camera, width, height, xoff, yoff, xsize, ysize, out, options.temporal, options.checkerboard, options.bgDist,
+			antialias ? depth.data() : nullptr, antialias ? material.data() : nullptr);
+		if (options.checkerboard >= 0)
+			reconstruct(out, xoff, yoff, xsize, ysize, options.checkerboard, options.history);
+		
+		std::vector<std::size_t> refined{};
+		if (antialias) {
+			const auto edges = find_edges(out, depth.data(), material.data(), xsize, ysize, options);
+			for (std::size_t i = 0; i < size; ++i) {
+				if (!edges[i]) continue;
+				refined.push_back(i);
+				for (int s = 1; s <= options.edge_samples; ++s)
+					rays.push_back(pixel(int(i % xsize), int(i / xsize), std::uint32_t(s)));
+			}
+			samples.resize(rays.size());
+			trace_packet(object, rays.data(), rays.size(), samples.data(), options.bgDist);
+		}
+		
+		const auto* sample = samples.data();
+		auto next = refined.begin();
+		for (std::size_t i = 0; i < size; ++i) {
+			Color sum = out[i];
+			std::uint32_t count = 1;
+			if (next != refined.end() && *next == i) {
+				for (int s = 0; s < options.edge_samples; ++s)
+					sum += *sample++;
+				count += std::uint32_t(options.edge_samples);
+				++next;
+			}
+			if (accumulation) out[i] = accumulation->add(xoff + int(i % xsize), yoff + int(i / xsize), sum, count);
+			else out[i] = sum / float(count);
+			// filled pixels are not worth remembering, the next frame traces them
+			const int x = xoff + int(i % xsize), y = yoff + int(i / xsize);
+			if (options.history && (options.checkerboard < 0 || ((x + y) & 1) == options.checkerboard))
+				options.history->store(x, y, out[i]);
+		}
+	}
+}
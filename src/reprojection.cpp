@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include "reprojection.hpp"
+#include "raytracer.hpp"
+#include "scheduler.hpp"
+
+namespace sdf {
+	static constexpr float no_hit = std::numeric_limits<float>::infinity();
+	
+	Reprojection::Reprojection(int width, int height)
+		: w(width), h(height), hits(std::size_t(width) * height, vec3{ no_hit }),
+		  splats(std::size_t(width) * height), starts(std::size_t(width) * height, 0.0f) {}
+	
+	void Reprojection::begin_frame(const PerspectiveCamera& camera, TaskPool& pool) {
+		const std::uint32_t empty = std::bit_cast<std::uint32_t>(no_hit);
+		for (auto& s : splats)
+			s.store(empty, std::memory_order_relaxed);
+		
+		// positive floats order like their bit patterns, so the nearest splat wins an integer minimum
+		pool.run(std::size_t(h), [&](std::size_t row) {
+			for (int x = 0; x < w; ++x) {
+				const vec3 q = hits[row * w + x];
+				if (!std::isfinite(q.x)) continue;
+				const vec3 p = camera.to_camera(q);
+				if (p.z >= 0.0f) continue;
+				const float u = 0.5f + p.x / -p.z * camera.focalLength / float(camera.sensorWidth);
+				const float v = 0.5f - p.y / -p.z * camera.focalLength / float(camera.sensorHeight);
+				const int px = int(std::floor(u * float(w))), py = int(std::floor(v * float(h)));
+				if (px < 0 || px >= w || py < 0 || py >= h) continue;
+				auto& slot = splats[std::size_t(py) * w + px];
+				const std::uint32_t depth = std::bit_cast<std::uint32_t>(glm::length(p));
+				std::uint32_t cur = slot.load(std::memory_order_relaxed);
+				while (depth < cur && !slot.compare_exchange_weak(cur, depth, std::memory_order_relaxed));
+			}
+		});
+		
+		// a pixel without a splat in its 3x3 neighbourhood (disocclusion, screen edge) starts at the camera
+		pool.run(std::size_t(h), [&](std::size_t row) {
+			const int y = int(row);
+			for (int x = 0; x < w; ++x) {
+				float depth = no_hit;
+				bool covered = true;
+				for (int j = std::max(0, y - 1); j <= std::min(h - 1, y + 1); ++j) {
+					for (int i = std::max(0, x - 1); i <= std::min(w - 1, x + 1); ++i) {
+						const float d = std::bit_cast<float>(splats[std::size_t(j) * w + i].load(std::memory_order_relaxed));
+						depth = std::min(depth, d);
+						covered &= std::isfinite(d);
+					}
+				}
+				starts[row * w + x] = covered && x > 0 && y > 0 && x < w - 1 && y < h - 1 ? safety * depth : 0.0f;
+			}
+		});
+	}
+	
+	void Reprojection::discard(int x0, int y0, int x1, int y1) noexcept {
+		for (int y = std::max(0, y0); y < std::min(h, y1); ++y)
+			for (int x = std::max(0, x0); x < std::min(w, x1); ++x)
+				starts[std::size_t(y) * w + x] = 0.0f;
+	}
+	void Reprojection::store(int x, int y, const Ray& ray, float depth) noexcept {
+		auto& hit = hits[std::size_t(y) * w + x];
+		if (!std::isfinite(depth)) {
+			hit = vec3{ no_hit };
+			return;
+		}
+		hit = ray.origin + ray.direction * depth;
+	}
+}
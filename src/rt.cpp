@@ -1,27 +1,170 @@
 #include <spdlog/spdlog.h>
+#include <vector>
 #include "raytracer.hpp"
+#include "reprojection.hpp"
+#include "profiler.hpp"
 
 namespace sdf {
-	[[nodiscard]]
-	static Color project_background(const Ray& ray) noexcept {
+	Color project_background(const Ray& ray) noexcept {
 		const auto dir = ray.direction;
 		if (dir.y < 0.0f) return { 0.1f, 0.4f, 0.1f, 1.0f };
 		else return { 2.0f * dir.y, 4.0f * dir.y, 1.0f, 1.0f };
 	}
 	
+	void PerspectiveCamera::pose(vec3 position, vec2 rotation) noexcept {
+		const float sx = std::sin(rotation.x), cx = std::cos(rotation.x), sy = std::sin(rotation.y), cy = std::cos(rotation.y);
+		eye = -position;
+		angles = rotation;
+		axes[0] = { cy, 0.0f, sy };
+		axes[1] = { -sy * sx, cx, cy * sx };
+		axes[2] = { -sy * cx, -sx, cy * cx };
+	}
 	Ray PerspectiveCamera::project(float x, float y) const noexcept {
-		static constexpr vec3 pos{ 0.0f, 0.0f, 0.0f };
-		return Ray{ pos, { (x - 0.5f) * float(sensorWidth), -(y - 0.5f) * float(sensorHeight), -focalLength } };
+		const vec3 d{ (x - 0.5f) * float(sensorWidth), -(y - 0.5f) * float(sensorHeight), -focalLength };
+		return Ray{ eye, d.x * axes[0] + d.y * axes[1] + d.z * axes[2] };
 	}
-
+	vec3 PerspectiveCamera::to_camera(vec3 p) const noexcept {
+		p -= eye;
+		return { glm::dot(axes[0], p), glm::dot(axes[1], p), glm::dot(axes[2], p) };
+	}
+	PixelRect PerspectiveCamera::screen_bounds(const Bounds& box, int width, int height) const noexcept {
+		const PixelRect all{ 0, 0, width, height };
+		if (!box.finite()) return all;
+		float u0 = std::numeric_limits<float>::infinity(), v0 = u0, u1 = -u0, v1 = -u0;
+		for (int i = 0; i < 8; ++i) {
+			const vec3 corner{ i & 1 ? box.upper.x : box.lower.x, i & 2 ? box.upper.y : box.lower.y, i & 4 ? box.upper.z : box.lower.z };
+			const vec3 p = to_camera(corner);
+			if (p.z > -1e-3f) return all;
+			const float u = 0.5f + p.x / -p.z * focalLength / float(sensorWidth);
+			const float v = 0.5f - p.y / -p.z * focalLength / float(sensorHeight);
+			u0 = std::min(u0, u), u1 = std::max(u1, u);
+			v0 = std::min(v0, v), v1 = std::max(v1, v);
+		}
+		// one more pixel on each side for the rays sampled off the pixel centers
+		const auto pixel = [](float f, int size, int pad) { return std::clamp(int(std::floor(std::clamp(f, 0.0f, 1.0f) * float(size))) + pad, 0, size); };
+		return { pixel(u0, width, -1), pixel(v0, height, -1), pixel(u1, width, 2), pixel(v1, height, 2) };
+	}
+	
+	float PerspectiveCamera::footprint(int width) const noexcept {
+		return float(sensorWidth) / (focalLength * float(width));
+	}
+	
+	static MarchSettings settings{};
+	
+	const MarchSettings& march_settings() noexcept { return settings; }
+	void set_march_settings(const MarchSettings& s) noexcept { settings = s; }
+	
+	MarchResult march(const Program& program, const Ray& ray, float bgDist, float start) noexcept {
+		const float far = std::min(bgDist, exit_distance(program.bounds, ray));
+		return march([&](vec3 p) { return program.distance(p); }, ray, far, settings, start);
+	}
+	
 	Color trace(const std::shared_ptr<Object>& object, Ray ray, float bgDist) {
-		auto ds = (*object)(ray.origin);
-		while (std::abs(ds.first) > 0.0001) {
-			ray.origin += ray.direction * ds.first;
-			ds = (*object)(ray.origin);
-			if (glm::length(ray.origin) >= bgDist)
-				return project_background(ray);
+		const float far = std::min(bgDist, exit_distance(object->bounds(), ray));
+		const auto result = march([&](vec3 p) { return (*object)(p).first; }, ray, far, settings);
+		ray.origin += ray.direction * result.t;
+		if (result.end == MarchEnd::Sky)
+			return project_background(ray);
+		return (*object)(ray.origin).second->shade(ray, object);
+	}
+	Color trace(const std::shared_ptr<CompiledObject>& object, Ray ray, float bgDist, float* depth, std::uint32_t* material) {
+		const auto& program = object->program;
+		const auto result = march(program, ray, bgDist);
+		ray.origin += ray.direction * result.t;
+		if (result.end == MarchEnd::Sky) {
+			if (depth) *depth = std::numeric_limits<float>::infinity();
+			if (material) *material = no_material;
+			return project_background(ray);
+		}
+		if (depth) *depth = result.t;
+		++thread_evaluations;
+		const auto hit = program.evaluate(ray.origin).second;
+		if (material) *material = hit;
+		return program.materials[hit]->shade(ray, object);
+	}
+	
+	float cone_march(const Program& program, const Ray& axis, float spread, float bgDist) noexcept {
+		constexpr int max_steps = 64;
+		// a ray of the cone at depth t + step stays within spread * t + (1 + spread) * step of the axis point at t
+		float t = 0.0f;
+		int i = 0;
+		for (; i < max_steps && t < bgDist; ++i) {
+			const float step = (program.distance(axis.origin + axis.direction * t) - spread * t) / (1.0f + spread);
+			if (step < 0.0001f) {
+				++i;
+				break;
+			}
+			t += step;
+		}
+		thread_evaluations += std::uint64_t(i);
+		return std::min(t, bgDist);
+	}
+	
+	void trace_region(const std::shared_ptr<CompiledObject>& object, const PerspectiveCamera& camera, int width, int height,
+			int xoff, int yoff, int xsize, int ysize, Color* out, Reprojection* temporal, int checkerboard, float bgDist,
+			float* depth, std::uint32_t* material, PixelCost* cost) {
+		const auto& program = object->program;
+		const auto pixel = [&](float x, float y) { return camera.project(x / float(width), y / float(height)); };
+		const std::size_t size = std::size_t(xsize) * ysize;
+		std::vector<Ray> rays(size);
+		std::vector<std::size_t> pixels(checkerboard < 0 ? 0 : size);
+		std::vector<float> depths(temporal || depth ? size : 0), starts(size);
+		std::size_t count = 0;
+		{
+			ProfileScope scope{ Stage::RayGen };
+			const int conesX = (xsize + cone_tile - 1) / cone_tile, conesY = (ysize + cone_tile - 1) / cone_tile;
+			std::vector<float> cones(std::size_t(conesX) * conesY);
+			for (int cy = 0; cy < conesY; ++cy) {
+				for (int cx = 0; cx < conesX; ++cx) {
+					const float x0 = float(xoff + cx * cone_tile), x1 = float(std::min(xoff + xsize, xoff + (cx + 1) * cone_tile));
+					const float y0 = float(yoff + cy * cone_tile), y1 = float(std::min(yoff + ysize, yoff + (cy + 1) * cone_tile));
+					const Ray axis = pixel(0.5f * (x0 + x1), 0.5f * (y0 + y1));
+					// the directions through the tile's outer corners bound all of its rays
+					float spread = 0.0f;
+					for (const auto [x, y] : { vec2{ x0, y0 }, vec2{ x1, y0 }, vec2{ x0, y1 }, vec2{ x1, y1 } })
+						spread = std::max(spread, glm::length(pixel(x, y).direction - axis.direction));
+					cones[std::size_t(cy) * conesX + cx] = cone_march(program, axis, spread, bgDist);
+				}
+			}
+			
+			for (int y0 = 0; y0 < ysize; ++y0) {
+				const int y = yoff + y0;
+				for (int x0 = 0; x0 < xsize; ++x0) {
+					const int x = xoff + x0;
+					if (checkerboard >= 0 && ((x + y) & 1) != checkerboard) continue;
+					if (checkerboard >= 0) pixels[count] = std::size_t(y0) * xsize + x0;
+					Ray& ray = rays[count++];
+					ray = pixel(float(x) + 0.5f, float(y) + 0.5f);
+					float t = cones[std::size_t(y0 / cone_tile) * conesX + x0 / cone_tile];
+					// a reprojected start may be stale, so it is only taken outside of geometry
+					if (temporal) {
+						const float warm = temporal->start(x, y);
+						if (warm > t) {
+							++thread_evaluations;
+							if (program.distance(ray.origin + ray.direction * warm) >= 0.0f) t = warm;
+						}
+					}
+					starts[count - 1] = t;
+				}
+			}
+		}
+		
+		// the rays of a full region are its pixels in order, checkerboards scatter theirs afterwards
+		std::vector<Color> traced(checkerboard < 0 ? 0 : count);
+		std::vector<std::uint32_t> materials(material && checkerboard >= 0 ? count : 0);
+		std::vector<PixelCost> costs(cost && checkerboard >= 0 ? count : 0);
+		trace_packet(object, rays.data(), count, checkerboard < 0 ? out : traced.data(), bgDist,
+			depths.empty() ? nullptr : depths.data(), !material ? nullptr : checkerboard < 0 ? material : materials.data(),
+			!cost ? nullptr : checkerboard < 0 ? cost : costs.data(), starts.data());
+		for (std::size_t i = 0; i < count; ++i) {
+			const std::size_t at = checkerboard < 0 ? i : pixels[i];
+			if (checkerboard >= 0) {
+				out[at] = traced[i];
+				if (material) material[at] = materials[i];
+				if (cost) cost[at] = costs[i];
+			}
+			if (depth) depth[at] = depths[i];
+			if (temporal) temporal->store(xoff + int(at % xsize), yoff + int(at / xsize), rays[i], depths[i]);
 		}
-		return ds.second->shade(ray, object);
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,258 @@
+#include <charconv>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "scene.hpp"
+
+namespace sdf {
+	SceneGraph demo_scene_graph() {
+		SceneGraph graph{};
+		const auto cube = graph.cube(1.0f, graph.material(std::make_shared<ShaderLambertian>(Color{ 0.1f, 0.1f, 0.9f, 1.0f })));
+		const auto obj = graph.translation(cube, vec3{ 1.8f, 0.0f, -10.0f });
+		const auto obj2 = graph.translation(cube, vec3{ 0.0f, 0.0f, -10.0f });
+		const auto obj3 = graph.translation(cube, vec3{ 1.8f, 1.0f, -10.0f });
+		const auto obj4 = graph.translation(cube, vec3{ 0.0f, 1.0f, -10.0f });
+		graph.root = graph.unite(graph.unite(obj, obj2), graph.unite(obj3, obj4));
+		return graph;
+	}
+	std::shared_ptr<Object> demo_scene() { return demo_scene_graph().freeze(); }
+	
+	namespace {
+		class SceneParser {
+		public:
+			explicit SceneParser(std::string_view text) noexcept : text(text) {}
+			
+			SceneGraph parse() {
+				for (auto word = token(); !word.empty(); word = token()) {
+					if (word == "material") {
+						const auto name = identifier();
+						const auto kind = token();
+						const Color color{ number(), number(), number(), 1.0f };
+						if (kind == "lambertian") materials[std::string(name)] = graph.material(std::make_shared<ShaderLambertian>(color));
+						else if (kind == "constant") materials[std::string(name)] = graph.material(std::make_shared<ShaderConstantColor>(color));
+						else fail("unknown material kind '" + std::string(kind) + "'");
+					}
+					else if (word == "define") {
+						const auto name = identifier();
+						objects[std::string(name)] = expression();
+					}
+					else if (word == "scene") {
+						if (graph.root != no_node) fail("more than one scene");
+						graph.root = expression();
+					}
+					else fail("expected material, define or scene, got '" + std::string(word) + "'");
+				}
+				if (graph.root == no_node) fail("no scene");
+				return std::move(graph);
+			}
+		private:
+			std::string_view text;
+			std::size_t pos = 0;
+			int line = 1;
+			SceneGraph graph{};
+			std::unordered_map<std::string, MaterialId> materials{};
+			std::unordered_map<std::string, NodeId> objects{};
+			
+			[[noreturn]]
+			void fail(const std::string& message) const {
+				throw std::runtime_error("scene line " + std::to_string(line) + ": " + message);
+			}
+			
+			// Braces are tokens of their own, an empty token marks the end of the text.
+			std::string_view token() noexcept {
+				while (pos < text.size()) {
+					const char c = text[pos];
+					if (c == '#') {
+						while (pos < text.size() && text[pos] != '\n') ++pos;
+					}
+					else if (std::isspace(static_cast<unsigned char>(c))) {
+						line += c == '\n';
+						++pos;
+					}
+					else break;
+				}
+				const std::size_t start = pos;
+				if (pos < text.size() && (text[pos] == '{' || text[pos] == '}')) ++pos;
+				else {
+					while (pos < text.size() && !std::isspace(static_cast<unsigned char>(text[pos])) && text[pos] != '{' && text[pos] != '}' && text[pos] != '#')
+						++pos;
+				}
+				return text.substr(start, pos - start);
+			}
+			std::string_view peek() noexcept {
+				const auto [oldPos, oldLine] = std::pair{ pos, line };
+				const auto word = token();
+				pos = oldPos;
+				line = oldLine;
+				return word;
+			}
+			void expect(std::string_view expected) {
+				if (token() != expected) fail("expected '" + std::string(expected) + "'");
+			}
+			std::string_view identifier() {
+				const auto word = token();
+				if (word.empty() || word == "{" || word == "}" || keyword(word)) fail("expected a name");
+				return word;
+			}
+			float number() {
+				const auto word = token();
+				float value = 0.0f;
+				const auto [end, error] = std::from_chars(word.data(), word.data() + word.size(), value);
+				if (word.empty() || error != std::errc{} || end != word.data() + word.size())
+					fail("expected a number, got '" + std::string(word) + "'");
+				return value;
+			}
+			int count() {
+				const float value = number();
+				if (value < 1.0f || value != std::floor(value)) fail("expected a positive count");
+				return int(value);
+			}
+			float cells() {
+				const float value = number();
+				if (value < 0.0f || value != std::floor(value)) fail("expected a cell count");
+				return value;
+			}
+			float radius() {
+				const float value = number();
+				if (!(value > 0.0f)) fail("expected a positive blend radius");
+				return value;
+			}
+			vec3 vector() { return { number(), number(), number() }; }
+			MaterialId material() {
+				const auto name = token();
+				const auto it = materials.find(std::string(name));
+				if (it == materials.end()) fail("unknown material '" + std::string(name) + "'");
+				return it->second;
+			}
+			[[nodiscard]]
+			static bool keyword(std::string_view word) noexcept {
+				for (const auto* k : { "material", "define", "scene", "sphere", "cube", "translate", "rotate_x", "rotate_y",
+						"scale", "affine", "union", "intersection", "subtraction", "instances", "array", "repeat", "repeat_limited", "mirror",
+						"smooth_union", "smooth_intersection", "smooth_subtraction" }) {
+					if (word == k) return true;
+				}
+				return false;
+			}
+			
+			NodeId expression() {
+				const auto word = token();
+				if (word == "sphere") {
+					const float radius = number();
+					return graph.sphere(radius, material());
+				}
+				if (word == "cube") {
+					const float size = number();
+					return graph.cube(size, material());
+				}
+				if (word == "translate") {
+					const vec3 offset = vector();
+					return graph.translation(expression(), offset);
+				}
+				if (word == "rotate_x" || word == "rotate_y") {
+					const float angle = number();
+					if (word == "rotate_x") return graph.rotation_x(expression(), angle);
+					return graph.rotation_y(expression(), angle);
+				}
+				if (word == "scale") {
+					const float factor = number();
+					if (!(factor > 0.0f)) fail("expected a positive scale");
+					const float inverse = 1.0f / factor;
+					return graph.affine(expression(), { inverse, 0.0f, 0.0f }, { 0.0f, inverse, 0.0f }, { 0.0f, 0.0f, inverse }, {});
+				}
+				if (word == "affine") {
+					const vec3 x = vector(), y = vector(), z = vector();
+					const vec3 offset = vector();
+					if (!(std::abs(glm::dot(x, glm::cross(y, z))) > 1e-12f)) fail("singular affine matrix");
+					// the graph stores the map from world to object space
+					const glm::mat3 inverse = glm::inverse(glm::transpose(glm::mat3{ x, y, z }));
+					const glm::mat3 rows = glm::transpose(inverse);
+					return graph.affine(expression(), rows[0], rows[1], rows[2], -(inverse * offset));
+				}
+				if (word == "intersection" || word == "subtraction") {
+					const auto a = expression();
+					const auto b = expression();
+					if (word == "intersection") return graph.intersection(a, b);
+					return graph.subtraction(a, b);
+				}
+				if (word == "union") {
+					expect("{");
+					NodeId result = expression();
+					while (peek() != "}")
+						result = graph.unite(result, expression());
+					expect("}");
+					return result;
+				}
+				if (word == "smooth_intersection" || word == "smooth_subtraction") {
+					const float k = radius();
+					const auto a = expression();
+					const auto b = expression();
+					if (word == "smooth_intersection") return graph.smooth_intersection(a, b, k);
+					return graph.smooth_subtraction(a, b, k);
+				}
+				if (word == "smooth_union") {
+					const float k = radius();
+					expect("{");
+					NodeId result = expression();
+					while (peek() != "}")
+						result = graph.smooth_union(result, expression(), k);
+					expect("}");
+					return result;
+				}
+				if (word == "repeat") {
+					const vec3 period = vector();
+					return graph.repetition(expression(), period);
+				}
+				if (word == "repeat_limited") {
+					const vec3 period = vector();
+					const vec3 limit{ cells(), cells(), cells() };
+					return graph.repetition(expression(), period, limit);
+				}
+				if (word == "mirror") {
+					const vec3 axes = vector();
+					return graph.mirror(expression(), axes.x != 0.0f, axes.y != 0.0f, axes.z != 0.0f);
+				}
+				if (word == "instances") {
+					const auto object = expression();
+					expect("{");
+					std::vector<vec3> offsets{};
+					while (peek() != "}")
+						offsets.push_back(vector());
+					expect("}");
+					return graph.instances(object, offsets);
+				}
+				if (word == "array") {
+					const int nx = count(), ny = count(), nz = count();
+					const vec3 step = vector();
+					const auto object = expression();
+					std::vector<vec3> offsets{};
+					offsets.reserve(std::size_t(nx) * ny * nz);
+					for (int k = 0; k < nz; ++k)
+						for (int j = 0; j < ny; ++j)
+							for (int i = 0; i < nx; ++i)
+								offsets.push_back(vec3{ float(i), float(j), float(k) } * step);
+					return graph.instances(object, offsets);
+				}
+				if (word.empty()) fail("unexpected end of the scene");
+				const auto it = objects.find(std::string(word));
+				if (it == objects.end()) fail("unknown object '" + std::string(word) + "'");
+				return it->second;
+			}
+		};
+	}
+	
+	SceneGraph parse_scene_graph(std::string_view text) {
+		return SceneParser{ text }.parse();
+	}
+	SceneGraph load_scene_graph(const std::string& path) {
+		std::ifstream in{ path, std::ios::binary };
+		if (!in) throw std::runtime_error("cannot open scene " + path);
+		std::ostringstream buffer{};
+		buffer << in.rdbuf();
+		return parse_scene_graph(buffer.str());
+	}
+	std::shared_ptr<Object> parse_scene(std::string_view text) { return parse_scene_graph(text).freeze(); }
+	std::shared_ptr<Object> load_scene(const std::string& path) { return load_scene_graph(path).freeze(); }
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "scheduler.hpp"
+
+namespace sdf {
+	TaskPool::TaskPool(std::size_t n) : queues(std::make_unique<Queue[]>(std::max<std::size_t>(n, 1))) {
+		n = std::max<std::size_t>(n, 1);
+		threads.reserve(n);
+		for (std::size_t i = 0; i < n; ++i)
+			threads.emplace_back(&TaskPool::worker, this, i);
+	}
+	TaskPool::~TaskPool() {
+		{
+			std::lock_guard lock{ mutex };
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& t : threads)
+			t.join();
+	}
+	std::size_t TaskPool::default_threads() noexcept {
+		const auto n = std::thread::hardware_concurrency();
+		return n ? n : 4;
+	}
+	
+	void TaskPool::run(std::size_t count, const Task& task) {
+		if (count == 0) return;
+		const std::size_t n = threads.size();
+		remaining = count;
+		// Neighbouring tasks start out on the same worker, idle workers steal from the back.
+		for (std::size_t w = 0; w < n; ++w) {
+			std::lock_guard lock{ queues[w].mutex };
+			for (std::size_t i = w * count / n; i < (w + 1) * count / n; ++i)
+				queues[w].jobs.push_back({ &task, i });
+		}
+		{
+			std::lock_guard lock{ mutex };
+			++generation;
+		}
+		wake.notify_all();
+		
+		std::unique_lock lock{ mutex };
+		done.wait(lock, [this] { return remaining == 0; });
+	}
+	
+	bool TaskPool::next(std::size_t id, Job& job) {
+		const std::size_t n = threads.size();
+		{
+			auto& own = queues[id];
+			std::lock_guard lock{ own.mutex };
+			if (!own.jobs.empty()) {
+				job = own.jobs.front();
+				own.jobs.pop_front();
+				return true;
+			}
+		}
+		for (std::size_t i = 1; i < n; ++i) {
+			auto& victim = queues[(id + i) % n];
+			std::lock_guard lock{ victim.mutex };
+			if (!victim.jobs.empty()) {
+				job = victim.jobs.back();
+				victim.jobs.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+	void TaskPool::worker(std::size_t id) {
+		std::size_t seen = 0;
+		while (true) {
+			{
+				std::unique_lock lock{ mutex };
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping) return;
+				seen = generation;
+			}
+			Job job{};
+			while (next(id, job)) {
+				(*job.task)(job.index);
+				if (--remaining == 0) {
+					std::lock_guard lock{ mutex };
+					done.notify_all();
+				}
+			}
+		}
+	}
+}
@@ -1,24 +1,45 @@
 #include <spdlog/spdlog.h>
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <array>
 #include <cstdlib>
 #include <chrono>
 #include "raytracer.hpp"
+#include "triple_buffer.hpp"
+#include "pixels.hpp"
+#include "profiler.hpp"
 #include "screen.hpp"
 
 namespace sdf {
 	using namespace std::chrono_literals;
-	vec3 camera_pos{};
-	vec2 camera_rotation{};
 	std::atomic_bool quit_requested;
 	static SDL_Window* window = nullptr;
-	static SDL_Surface* globalSurface = nullptr;
 	static SDL_Texture* texture = nullptr;
-	static std::mutex texture_mutex{};
 	static SDL_Renderer* windowRenderer = nullptr;
 	static std::atomic_bool initialized = false;
+	// XRGB8888 pixels of a frame rendered at up to the full surface size, rows are width pixels apart
+	struct Frame {
+		std::vector<std::uint32_t> pixels;
+		int width, height;
+	};
+	// render workers fill the back buffer and the display thread uploads the front one
+	static int surfaceWidth = 0, surfaceHeight = 0;
+	static std::unique_ptr<TripleBuffer<Frame>> frames;
+	// per buffer, the tiles drawn into another one since it was last the back buffer
+	constexpr int stale_tile = 16;
+	static int staleColumns = 0;
+	static std::array<std::unique_ptr<std::atomic_bool[]>, 3> stale{};
+	// the input thread publishes, the render thread acquires
+	static TripleBuffer<FrameState> states{};
+	static std::atomic_uint64_t scene_version{ 0 };
 	
 	bool screen_initialized() noexcept { return initialized; }
-	std::pair<int, int> surfaceSize() noexcept { return { globalSurface->w, globalSurface->h }; }
+	FrameState acquire_frame_state() noexcept {
+		states.acquire();
+		return states.front();
+	}
+	void scene_changed() noexcept { scene_version.fetch_add(1, std::memory_order_relaxed); }
+	std::pair<int, int> surfaceSize() noexcept { return { surfaceWidth, surfaceHeight }; }
 	static bool quit() {
 		spdlog::debug("Quitting...");
 		quit_requested = true;
@@ -27,7 +48,7 @@ namespace sdf {
 	}
 	
 	void init_screen(int width, int height, int scale) {
-		if (window || globalSurface) return;
+		if (window || frames) return;
 		spdlog::set_level(spdlog::level::debug);
 		if (SDL_Init(SDL_INIT_VIDEO)) {
 			spdlog::critical("Failed to initialize SDL2: {}", SDL_GetError());
@@ -68,27 +89,32 @@ namespace sdf {
 			spdlog::info("Renderer Flags: {}", flags_str);
 		}
 		else spdlog::warn("Failed to get Renderer Info");
-		globalSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 24, SDL_PIXELFORMAT_RGB888);
-		if (!globalSurface) {
-			spdlog::critical("Failed to create surface: {}", SDL_GetError());
-			std::exit(1);
-		}
-		//texture = SDL_CreateTextureFromSurface(windowRenderer, globalSurface);
-		texture = SDL_CreateTexture(windowRenderer, globalSurface->format->format, SDL_TEXTUREACCESS_STREAMING, globalSurface->w, globalSurface->h);
+		surfaceWidth = width, surfaceHeight = height;
+		frames = std::make_unique<TripleBuffer<Frame>>(Frame{ std::vector<std::uint32_t>(std::size_t(width) * height), width, height });
+		staleColumns = (width + stale_tile - 1) / stale_tile;
+		for (auto& tiles : stale)
+			tiles = std::make_unique<std::atomic_bool[]>(std::size_t(staleColumns) * ((height + stale_tile - 1) / stale_tile));
+		texture = SDL_CreateTexture(windowRenderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, width, height);
 		if (!texture) {
 			spdlog::critical("Failed to create Texture: {}", SDL_GetError());
-			std:exit(1);
+			std::exit(1);
 		}
-		spdlog::debug("Created Surface with size [{},{}]", globalSurface->w, globalSurface->h);
+		spdlog::debug("Created frame buffers with size [{},{}]", width, height);
 		
 		initialized = true;
 		
 		const auto now = []{ return std::chrono::high_resolution_clock::now(); };
+		const auto startTime = now();
 		auto lastFrame = now();
+		vec3 position{};
+		vec2 rotation{};
+		std::uint64_t version = 0;
+		bool profiling = false, heatmap = false, animate = false;
 		
 		constexpr float speed = 4.0f, rotate_speed = 200.0f;
 		bool up{}, down{}, forward{}, backward{}, left{}, right{};
 		bool focus = true;
+		SDL_Rect shown{ 0, 0, width, height };
 		while (true) {
 			const auto curFrame = now();
 			const auto delta = std::chrono::duration_cast<std::chrono::microseconds>(curFrame - lastFrame).count() / 1000000.0f;
@@ -109,6 +135,9 @@ namespace sdf {
 					case SDLK_SPACE: up = state; break;
 					case SDLK_LSHIFT: down = state; break;
 					case SDLK_F11: SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP); break;
+					case SDLK_F2: if (state) profiling = !profiling; break;
+					case SDLK_F3: if (state) heatmap = !heatmap; break;
+					case SDLK_F4: if (state) animate = !animate; break;
 					}
 					break;
 				}
@@ -126,69 +155,87 @@ namespace sdf {
 			const int dir_z = (forward && !backward) - (!forward && backward);
 			const int dir_y = (up && !down) - (!up && down);
 			const int dir_x = (left && !right) - (!left && right);
-			camera_pos.z += dir_z * speed * std::cos(camera_rotation.y) * delta;
-			camera_pos.x -= dir_z * speed * std::sin(camera_rotation.y) * delta;
-			camera_pos.z += dir_x * speed * std::sin(camera_rotation.y) * delta;
-			camera_pos.x += dir_x * speed * std::cos(camera_rotation.y) * delta;
-			camera_pos.y -= dir_y * speed * delta;
+			position.z += dir_z * speed * std::cos(rotation.y) * delta;
+			position.x -= dir_z * speed * std::sin(rotation.y) * delta;
+			position.z += dir_x * speed * std::sin(rotation.y) * delta;
+			position.x += dir_x * speed * std::cos(rotation.y) * delta;
+			position.y -= dir_y * speed * delta;
 			
-			camera_rotation.y += dx * rotate_speed * delta;
-			camera_rotation.x -= dy * rotate_speed * delta;
+			rotation.y += dx * rotate_speed * delta;
+			rotation.x -= dy * rotate_speed * delta;
 			
-			if (focus) SDL_WarpMouseInWindow(window, width / 2, height / 2);
+			states.back() = { ++version, std::chrono::duration<float>(curFrame - startTime).count(),
+				scene_version.load(std::memory_order_relaxed), position, rotation, profiling, heatmap, animate };
+			states.publish();
 			
-			//SDL_BlitScaled(surface, nullptr, SDL_GetWindowSurface(window), nullptr);
-			//SDL_UpdateWindowSurface(window);
+			if (focus) SDL_WarpMouseInWindow(window, width / 2, height / 2);
 			
-			SDL_UpdateTexture(texture, nullptr, globalSurface->pixels, globalSurface->pitch);
+			// only completed frames reach the texture, reduced resolutions get scaled up by the renderer
+			if (frames->acquire()) {
+				const auto& frame = frames->front();
+				shown = { 0, 0, frame.width, frame.height };
+				SDL_UpdateTexture(texture, &shown, frame.pixels.data(), frame.width * int(sizeof(std::uint32_t)));
+			}
 			SDL_RenderClear(windowRenderer);
-			SDL_RenderCopy(windowRenderer, texture, nullptr, nullptr);
+			SDL_RenderCopy(windowRenderer, texture, &shown, nullptr);
 			SDL_RenderPresent(windowRenderer);
 			
 			lastFrame = curFrame;
 			std::this_thread::sleep_for(2ms);
 		}
 	end:;
-		SDL_FreeSurface(globalSurface);
+		SDL_DestroyTexture(texture);
 		SDL_DestroyWindow(window);
 		SDL_Quit();
 		std::exit(0);
 	}
 	
+	static PixelEncoding encoding{};
+	
+	// the other two buffers miss pixels [x0, x1) x [y0, y1) of the back buffer, render workers mark them concurrently
+	static void mark_stale(int x0, int y0, int x1, int y1) noexcept {
+		if (x0 >= x1 || y0 >= y1) return;
+		const std::size_t back = frames->back_slot();
+		for (std::size_t slot = 0; slot < stale.size(); ++slot) {
+			if (slot == back) continue;
+			for (int ty = y0 / stale_tile; ty < (y1 + stale_tile - 1) / stale_tile; ++ty)
+				for (int tx = x0 / stale_tile; tx < (x1 + stale_tile - 1) / stale_tile; ++tx)
+					stale[slot][std::size_t(ty * staleColumns + tx)].store(true, std::memory_order_relaxed);
+		}
+	}
+	
+	void set_pixel_encoding(PixelEncoding e) noexcept { encoding = e; }
 	void draw(int x, int y, Color color) {
-		const SDL_Rect rect = { x, y, 1, 1 };
-		const auto r = uint8_t(color.x * 255.0f);
-		const auto g = uint8_t(color.y * 255.0f);
-		const auto b = uint8_t(color.z * 255.0f);
-		SDL_FillRect(globalSurface, &rect, SDL_MapRGB(globalSurface->format, r, g, b));
+		auto& frame = frames->back();
+		encode_argb(&color, &frame.pixels[std::size_t(y) * frame.width + x], 1, x, y, encoding);
+		mark_stale(x, y, x + 1, y + 1);
 	}
-	void blit(SDL_Surface* surface, int x, int y) {
-		SDL_Rect rect = { x, y, surface->w, surface->h };
-		SDL_BlitSurface(surface, nullptr, globalSurface, &rect);
-		
-		/*texture_mutex.lock();
-		SDL_UpdateTexture(texture, &rect, surface->pixels, surface->pitch);
-		texture_mutex.unlock();*/
+	std::pair<int, int> frameSize() noexcept {
+		const auto& frame = frames->back();
+		return { frame.width, frame.height };
 	}
-	SDL_Surface* createSubSurface(int ysize) {
-		const int h = std::clamp(ysize, 0, globalSurface->h);
-		return SDL_CreateRGBSurfaceWithFormat(0, globalSurface->w, h, globalSurface->format->BitsPerPixel, globalSurface->format->format);
+	void resize_frame(int width, int height) noexcept {
+		auto& frame = frames->back();
+		frame.width = std::clamp(width, 1, surfaceWidth);
+		frame.height = std::clamp(height, 1, surfaceHeight);
 	}
-	void renderSurface(SDL_Surface* surface, const PerspectiveCamera& camera, const std::shared_ptr<Object>& obj, int yoff, int ysize, int xoff, int xsize) {
-		const int gw = globalSurface->w, gh = globalSurface->h;
-		yoff = std::clamp(yoff, 0, gh);
-		ysize = std::clamp(ysize, 0, gh - yoff);
-		xoff = std::clamp(xoff, 0, gw);
-		xsize = std::clamp(xsize, 0, gw - xoff);
-		for (int y0 = 0; y0 < ysize; ++y0) {
-			const int y = y0 + yoff;
-			for (int x0 = 0; x0 < xsize; ++x0) {
-				const int x = x0 + xoff;
-				const SDL_Rect rect = { x0, y0, 1, 1 };
-				const auto ray = camera.project((float(x) + 0.5f) / float(gw), (float(y) + 0.5f) / float(gh));
-				const auto color = trace(obj, ray);
-				const auto rgb = SDL_MapRGB(surface->format, uint8_t(color.x * 255.0f), uint8_t(color.y * 255.0f), uint8_t(color.z * 255.0f));
-				SDL_FillRect(surface, &rect, rgb);
+	void present_frame() {
+		const Frame& presented = frames->back();
+		frames->publish();
+		// the display thread only ever reads the presented frame
+		auto& next = frames->back();
+		auto& missing = stale[frames->back_slot()];
+		// rows of a buffer last used at another resolution are laid out differently, all of it is stale
+		const bool resized = next.width != presented.width || next.height != presented.height;
+		next.width = presented.width, next.height = presented.height;
+		for (int ty = 0; ty * stale_tile < next.height; ++ty) {
+			for (int tx = 0; tx * stale_tile < next.width; ++tx) {
+				if (!missing[std::size_t(ty * staleColumns + tx)].exchange(false, std::memory_order_relaxed) && !resized) continue;
+				const int x = tx * stale_tile, w = std::min(stale_tile, next.width - x);
+				for (int y = ty * stale_tile; y < std::min(next.height, (ty + 1) * stale_tile); ++y) {
+					const auto row = std::size_t(y) * next.width + std::size_t(x);
+					std::copy_n(presented.pixels.begin() + std::ptrdiff_t(row), w, next.pixels.begin() + std::ptrdiff_t(row));
+				}
 			}
 		}
 	}
@@ -204,7 +251,22 @@ namespace sdf {
 				draw(x, y, trace(obj, ray));
 			}
 		}*/
-		renderSurface(globalSurface, camera, obj, yoff, ysize, xoff, xsize);
+		render(camera, std::make_shared<CompiledObject>(*obj), yoff, ysize, xoff, xsize);
+	}
+	void render(const PerspectiveCamera& camera, const std::shared_ptr<CompiledObject>& obj, int yoff, int ysize, int xoff, int xsize, const RenderOptions& options) {
+		auto& frame = frames->back();
+		const int gw = frame.width, gh = frame.height;
+		yoff = std::clamp(yoff, 0, gh);
+		ysize = std::clamp(ysize, 0, gh - yoff);
+		xoff = std::clamp(xoff, 0, gw);
+		xsize = std::clamp(xsize, 0, gw - xoff);
+		// the region goes straight into the back buffer
+		std::vector<Color> colors(std::size_t(xsize) * ysize);
+		render_region(obj, camera, gw, gh, xoff, yoff, xsize, ysize, colors.data(), options);
+		ProfileScope scope{ Stage::Blit };
+		for (int y = 0; y < ysize; ++y)
+			encode_argb(&colors[std::size_t(y) * xsize], &frame.pixels[std::size_t(yoff + y) * gw + xoff], std::size_t(xsize), xoff, yoff + y, encoding);
+		mark_stale(xoff, yoff, xoff + xsize, yoff + ysize);
 	}
 	void set_fps(float fps) {
 		std::string tmp = "Signed Distance Fields Demo | FPS:" + std::to_string(fps);
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "sequence.hpp"
+
+namespace sdf {
+	std::vector<CameraKey> parse_camera_path(std::string_view text) {
+		std::vector<CameraKey> path{};
+		int line = 0;
+		while (!text.empty()) {
+			++line;
+			const std::size_t eol = std::min(text.find('\n'), text.size());
+			std::string_view rest = text.substr(0, std::min(eol, text.find('#')));
+			text.remove_prefix(std::min(eol + 1, text.size()));
+			
+			float values[6];
+			int count = 0;
+			for (;;) {
+				while (!rest.empty() && std::isspace(static_cast<unsigned char>(rest.front()))) rest.remove_prefix(1);
+				if (rest.empty()) break;
+				std::size_t end = 0;
+				while (end < rest.size() && !std::isspace(static_cast<unsigned char>(rest[end]))) ++end;
+				const auto word = rest.substr(0, end);
+				rest.remove_prefix(end);
+				float value = 0.0f;
+				const auto [last, error] = std::from_chars(word.data(), word.data() + word.size(), value);
+				if (count == 6 || error != std::errc{} || last != word.data() + word.size())
+					throw std::runtime_error("camera path line " + std::to_string(line) + ": expected FRAME X Y Z PITCH YAW");
+				values[count++] = value;
+			}
+			if (count == 0) continue;
+			if (count != 6)
+				throw std::runtime_error("camera path line " + std::to_string(line) + ": expected FRAME X Y Z PITCH YAW");
+			if (!path.empty() && !(values[0] > path.back().frame))
+				throw std::runtime_error("camera path line " + std::to_string(line) + ": frames must increase");
+			path.push_back({ values[0], { values[1], values[2], values[3] }, { values[4], values[5] } });
+		}
+		if (path.empty()) throw std::runtime_error("camera path without keys");
+		return path;
+	}
+	std::vector<CameraKey> load_camera_path(const std::string& path) {
+		std::ifstream in{ path, std::ios::binary };
+		if (!in) throw std::runtime_error("cannot open camera path " + path);
+		std::ostringstream buffer{};
+		buffer << in.rdbuf();
+		return parse_camera_path(buffer.str());
+	}
+	
+	CameraKey camera_at(const std::vector<CameraKey>& path, float frame) noexcept {
+		const auto next = std::upper_bound(path.begin(), path.end(), frame, [](float f, const CameraKey& key) { return f < key.frame; });
+		if (next == path.begin()) return { frame, path.front().position, path.front().rotation };
+		if (next == path.end()) return { frame, path.back().position, path.back().rotation };
+		const auto& a = *(next - 1);
+		const auto& b = *next;
+		const float t = (frame - a.frame) / (b.frame - a.frame);
+		return { frame, a.position + (b.position - a.position) * t, a.rotation + (b.rotation - a.rotation) * t };
+	}
+	
+	// BT.601 in limited range with 8 bit fixed point weights
+	[[nodiscard]]
+	static std::uint8_t luma(int r, int g, int b) noexcept { return std::uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+	[[nodiscard]]
+	static std::uint8_t blue_difference(int r, int g, int b) noexcept { return std::uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128); }
+	[[nodiscard]]
+	static std::uint8_t red_difference(int r, int g, int b) noexcept { return std::uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128); }
+	
+	bool VideoWriter::write(const Framebuffer& frame) {
+		if (failed) return false;
+		const std::uint8_t* pixels = frame.pixels.data();
+		const std::size_t count = std::size_t(width) * height;
+		if (format == VideoFormat::RGB) {
+			buffer.resize(count * 3);
+			for (std::size_t i = 0; i < count; ++i)
+				std::copy_n(pixels + i * 4, 3, buffer.data() + i * 3);
+		}
+		else {
+			if (!started) std::fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps);
+			std::fputs("FRAME\n", out);
+			// chroma planes cover 2x2 pixel blocks, rounded up at odd sizes
+			const int cw = (width + 1) / 2, ch = (height + 1) / 2;
+			buffer.resize(count + 2 * std::size_t(cw) * ch);
+			std::uint8_t* y = buffer.data();
+			std::uint8_t* cb = y + count;
+			std::uint8_t* cr = cb + std::size_t(cw) * ch;
+			for (std::size_t i = 0; i < count; ++i)
+				y[i] = luma(pixels[i * 4], pixels[i * 4 + 1], pixels[i * 4 + 2]);
+			for (int by = 0; by < ch; ++by) {
+				for (int bx = 0; bx < cw; ++bx) {
+					int r = 0, g = 0, b = 0, n = 0;
+					for (int py = 2 * by; py < std::min(height, 2 * by + 2); ++py) {
+						for (int px = 2 * bx; px < std::min(width, 2 * bx + 2); ++px, ++n) {
+							const std::uint8_t* p = pixels + (std::size_t(py) * width + px) * 4;
+							r += p[0], g += p[1], b += p[2];
+						}
+					}
+					r = (r + n / 2) / n, g = (g + n / 2) / n, b = (b + n / 2) / n;
+					cb[std::size_t(by) * cw + bx] = blue_difference(r, g, b);
+					cr[std::size_t(by) * cw + bx] = red_difference(r, g, b);
+				}
+			}
+		}
+		started = true;
+		failed = std::fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size() || std::fflush(out) != 0;
+		return !failed;
+	}
+}
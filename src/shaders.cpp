@@ -1,5 +1,6 @@
 #include "raytracer.hpp"
 #include "shader.hpp"
+#include "lighting.hpp"
 
 namespace sdf {
 	Color ShaderConstantColor::shade(const Ray& ray, const std::shared_ptr<Object>& object) const noexcept {
@@ -9,7 +10,12 @@ namespace sdf {
 		const auto [lightDir, lightColor] = object->sampleDirectionalLight();
 		const auto normal = object->normal(ray.origin);
 		
-		const vec3 tmp = (vec3{color.x, color.y, color.z} * lightColor) * std::clamp(glm::dot(normal, lightDir), 0.0f, 1.0f);
+		// faces turned away from the light need no shadow ray
+		float direct = std::clamp(glm::dot(normal, lightDir), 0.0f, 1.0f);
+		if (direct > 0.0f) direct *= object->shadow(ray.origin, normal, lightDir);
+		const float ambient = lighting_settings().ambient;
+		const float indirect = ambient > 0.0f ? ambient * object->occlusion(ray.origin, normal) : 0.0f;
+		const vec3 tmp = vec3{color.x, color.y, color.z} * (lightColor * direct + indirect);
 		return { tmp.x, tmp.y, tmp.z, color.w };
 	}
 }
\ No newline at end of file
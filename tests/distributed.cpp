@@ -0,0 +1,98 @@
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "framebuffer.hpp"
+#include "lighting.hpp"
+#include "raytracer.hpp"
+#include "scene.hpp"
+#include "scheduler.hpp"
+#include "distributed.hpp"
+
+using namespace sdf;
+
+// Traces tiles with forked workers and checks the frames against the threaded renderer's, also after one worker is
+// killed or hangs in the middle of a frame.
+
+constexpr int width = 192, height = 112, tile = 16, workerTile = 48;
+
+// what the worker given the tile at (x, y) does next, the first one to see it takes it
+enum class Fault { None, Kill, Hang };
+struct Trigger {
+	std::atomic<Fault> fault{ Fault::None };
+	int x = 0, y = 0;
+};
+
+static PerspectiveCamera camera{};
+static std::shared_ptr<CompiledObject> object{};
+
+// traces pixels [x, x + w) x [y, y + h) in the tiles of the threaded renderer, so both trace the same packets
+static void trace(Framebuffer& fb, int x, int y, int w, int h) {
+	for (int ty = y; ty < y + h; ty += tile)
+		for (int tx = x; tx < x + w; tx += tile)
+			render(fb, camera, object, ty, std::min(tile, y + h - ty), tx, std::min(tile, x + w - tx));
+}
+
+static bool check(const char* name, std::size_t workers, Fault fault, Trigger& trigger, const Framebuffer& expected, std::size_t survivors) {
+	trigger.fault = fault;
+	TileWorkers::Renderer serve = [&trigger](Framebuffer& target, const Tile& t) {
+		if (t.x == trigger.x && t.y == trigger.y) {
+			const Fault taken = trigger.fault.exchange(Fault::None);
+			if (taken == Fault::Kill) ::raise(SIGKILL);
+			if (taken == Fault::Hang) ::pause();
+		}
+		trace(target, t.x, t.y, t.width, t.height);
+	};
+	TileWorkers pool{ workers, width, height, expected.encoding, serve, std::chrono::milliseconds(500) };
+	Framebuffer fb{ width, height };
+	fb.encoding = expected.encoding;
+	const bool rendered = pool.render(fb, workerTile);
+	const bool ok = rendered && fb.pixels == expected.pixels && pool.size() == survivors && trigger.fault == Fault::None;
+	std::printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+	if (!ok)
+		std::printf("  rendered %d, same pixels %d, %zu of %zu workers left\n", rendered, fb.pixels == expected.pixels, pool.size(), survivors);
+	return ok;
+}
+
+int main() {
+	spdlog::set_level(spdlog::level::err);
+	camera.pose({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f });
+	auto lighting = lighting_settings();
+	lighting.eye = camera.origin();
+	set_lighting_settings(lighting);
+	object = std::make_shared<CompiledObject>(demo_scene_graph().compile());
+	
+	// the trigger lives in memory the workers share with each other and with us
+	void* shared = ::mmap(nullptr, sizeof(Trigger), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		std::perror("mmap");
+		return 1;
+	}
+	auto& trigger = *new (shared) Trigger{};
+	// a tile in the middle of the frame, so the worker dies with tiles behind it and others in flight
+	trigger.x = workerTile * 2;
+	trigger.y = workerTile;
+	
+	Framebuffer expected{ width, height };
+	{
+		// its threads are gone again before the workers fork
+		TaskPool threads{ 2 };
+		const int columns = (width + tile - 1) / tile, rows = (height + tile - 1) / tile;
+		threads.run(std::size_t(columns * rows), [&](std::size_t i) {
+			const int x = int(i) % columns * tile, y = int(i) / columns * tile;
+			render(expected, camera, object, y, std::min(tile, height - y), x, std::min(tile, width - x));
+		});
+	}
+	
+	bool ok = check("two workers", 2, Fault::None, trigger, expected, 2);
+	ok = check("three workers", 3, Fault::None, trigger, expected, 3) && ok;
+	ok = check("killed worker", 3, Fault::Kill, trigger, expected, 2) && ok;
+	ok = check("hung worker", 2, Fault::Hang, trigger, expected, 1) && ok;
+	::munmap(shared, sizeof(Trigger));
+	return ok ? 0 : 1;
+}